@@ -0,0 +1,557 @@
+//============================================================================
+// Name        : Fft.cpp
+// Author      : -
+// Version     : 1.0
+// Copyright   : -
+// Description : fourier transformation shared by the AIA assignments
+//============================================================================
+
+#include "Fft.h"
+
+map< pair<int, bool>, FftPlan > Fft::plans;
+mutex Fft::plansLock;
+atomic<long long> Fft::count(0);
+
+// minimal number of elements of a 2-D transformation to be split across threads
+static const int parallelSize = 64 * 64;
+
+// lengths with a larger prime factor are transformed by Bluestein's algorithm instead of a butterfly of that radix
+static const int bluesteinRadix = 13;
+
+// twiddle factors of a plan in the working precision
+static inline const complex<double>* twiddles(const FftPlan& plan, double) {
+	return &plan.twiddle[0];
+}
+static inline const complex<float>* twiddles(const FftPlan& plan, float) {
+	return &plan.twiddle32[0];
+}
+
+// chirp of Bluestein's algorithm and its spectrum in the working precision
+static inline const complex<double>* chirp(const FftPlan& plan, double) {
+	return &plan.chirp[0];
+}
+static inline const complex<float>* chirp(const FftPlan& plan, float) {
+	return &plan.chirp32[0];
+}
+static inline const complex<double>* chirpSpectrum(const FftPlan& plan, double) {
+	return &plan.chirpSpectrum[0];
+}
+static inline const complex<float>* chirpSpectrum(const FftPlan& plan, float) {
+	return &plan.chirpSpectrum32[0];
+}
+
+// largest prime factor of a length
+static int largestPrimeFactor(int n) {
+
+	int largest = 1;
+	for (int p = 2; p * p <= n; p++) {
+		while (n % p == 0) {
+			largest = p;
+			n /= p;
+		}
+	}
+	return std::max(largest, n);
+}
+
+// transforms the rows of a real or complex matrix of depth S into a complex matrix of working precision T
+/*
+each row is converted while it is read, so the input is never copied as a whole; zero rows (e.g. outside of a template)
+are not transformed. the line buffers are kept per thread; the matrices may be regions of larger ones, and data may
+share its memory with src if both have the same type
+*/
+template <typename S, typename T>
+class FftRowsBody : public ParallelLoopBody {
+
+	public:
+		FftRowsBody(const Mat& src, Mat& data, const FftPlan& plan) : src(src), data(data), plan(plan) {};
+
+		void operator()(const Range& range) const {
+			static thread_local vector< complex<T> > in, line;
+			in.resize(plan.n);
+			line.resize(plan.n);
+			bool complexInput = src.channels() == 2;
+			for (int k = range.start; k < range.end; k++) {
+				const S* s = src.ptr<S>(k);
+				bool zero = true;
+				for (int x = 0; x < plan.n; x++) {
+					in[x] = complexInput ? complex<T>((T)s[2 * x], (T)s[2 * x + 1]) : complex<T>((T)s[x], 0);
+					zero = zero && (in[x] == complex<T>(0, 0));
+				}
+				complex<T>* row = data.ptr< complex<T> >(k);
+				if (zero) {
+					std::fill(row, row + plan.n, complex<T>(0, 0));
+					continue;
+				}
+				Fft::transform(plan, &in[0], 1, &line[0]);
+				std::copy(line.begin(), line.begin() + plan.n, row);
+			}
+		}
+
+	private:
+		const Mat& src;
+		Mat& data;
+		const FftPlan& plan;
+};
+
+// transforms the columns of a complex matrix of working precision T into a matrix of depth D
+/*
+the output is scaled and converted while it is written: complex, or the real part only if dst has one channel.
+the line buffer is kept per thread; dst may be data itself if it is complex of depth T
+*/
+template <typename T, typename D>
+class FftColumnsBody : public ParallelLoopBody {
+
+	public:
+		FftColumnsBody(Mat& data, Mat& dst, const FftPlan& plan, T gain) : data(data), dst(dst), plan(plan), gain(gain) {};
+
+		void operator()(const Range& range) const {
+			static thread_local vector< complex<T> > line;
+			line.resize(plan.n);
+			const complex<T>* base = data.ptr< complex<T> >(0);
+			int stride = (int)(data.step / sizeof(complex<T>));
+			bool realOutput = dst.channels() == 1;
+			for (int k = range.start; k < range.end; k++) {
+				Fft::transform(plan, base + k, stride, &line[0]);
+				for (int y = 0; y < plan.n; y++) {
+					complex<T> v = line[y] * gain;
+					D* d = dst.ptr<D>(y);
+					if (realOutput) {
+						d[k] = (D)v.real();
+					}
+					else {
+						d[2 * k] = (D)v.real();
+						d[2 * k + 1] = (D)v.imag();
+					}
+				}
+			}
+		}
+
+	private:
+		Mat& data;
+		Mat& dst;
+		const FftPlan& plan;
+		T gain;
+};
+
+// discrete fourier transformation
+/*
+supports real input with DFT_COMPLEX_OUTPUT, complex input, DFT_INVERSE, DFT_SCALE and DFT_REAL_OUTPUT (real part of
+an inverse transformation); packed (CCS) spectra and DFT_ROWS are passed to cv::dft(..).
+double precision input is always transformed in double precision, single precision input in the given working precision;
+single precision halves the memory of the working copy (as cv::dft(..)), double precision reduces the rounding errors.
+the rows are read from the input and converted on the fly, the columns are written to dst scaled and converted; the
+complex matrix in between is dst itself if it has the working precision, otherwise a working copy kept per thread,
+hence repeated transformations of equal size allocate no memory and the input is never copied as a whole.
+src:	input matrix, CV_32F or CV_64F with one or two channels
+dst:	output matrix, same depth as src; may be src
+flags:	transformation flags as for cv::dft(..)
+workDepth:	working precision for single precision input, CV_32F or CV_64F
+*/
+void Fft::dft(const Mat& src, Mat& dst, int flags, int workDepth) {
+
+	count++;
+
+#ifdef AIA_FFT_OPENCV
+	cv::dft(src, dst, flags);
+#else
+	int depth = src.depth();
+	bool inverse = (flags & DFT_INVERSE) != 0;
+	bool complexInput = src.channels() == 2;
+	bool supported = !(flags & DFT_ROWS) && ((depth == CV_32F) || (depth == CV_64F))
+		&& (complexInput || ((src.channels() == 1) && !inverse && (flags & DFT_COMPLEX_OUTPUT)))
+		&& (inverse || !(flags & DFT_REAL_OUTPUT));
+	if (!supported) {
+		cv::dft(src, dst, flags);
+		return;
+	}
+
+	CV_Assert((workDepth == CV_32F) || (workDepth == CV_64F));
+	workDepth = (depth == CV_64F) ? CV_64F : workDepth;
+	bool realOutput = inverse && (flags & DFT_REAL_OUTPUT);
+	double gain = (flags & DFT_SCALE) ? 1. / src.total() : 1.;
+
+	// the header keeps the input alive if dst is src and gets reallocated
+	Mat source = src;
+	dst.create(src.rows, src.cols, CV_MAKETYPE(depth, realOutput ? 1 : 2));
+
+	// rows are transformed from the input into the complex matrix of working precision, which is dst itself or the
+	// working copy of this thread; columns are transformed from there into dst
+	static thread_local Mat buffer;
+	Mat data = dst;
+	if (realOutput || (depth != workDepth)) {
+		buffer.create(src.rows, src.cols, CV_MAKETYPE(workDepth, 2));
+		data = buffer;
+	}
+
+	if (depth == CV_64F) {
+		transform2D<double, double, double>(source, data, dst, inverse, gain);
+	}
+	else if (workDepth == CV_64F) {
+		transform2D<float, double, float>(source, data, dst, inverse, gain);
+	}
+	else {
+		transform2D<float, float, float>(source, data, dst, inverse, gain);
+	}
+#endif
+}
+
+// conjugate product of two spectra, inversely transformed in the working buffer
+/*
+the product is written directly into the working copy of the working precision; the inverse transformation is not
+scaled, see correlate(..)
+spectrum:		first spectrum (CV_32FC2)
+maskSpectrum:	second spectrum, conjugated (CV_32FC2, same size as spectrum)
+work:			buffer of the working copy, reused if it has the right size and type
+workDepth:		working precision, CV_32F or CV_64F
+*/
+void Fft::inverseProduct(const Mat& spectrum, const Mat& maskSpectrum, Mat& work, int workDepth) {
+
+	CV_Assert((spectrum.type() == CV_32FC2) && (maskSpectrum.type() == CV_32FC2) && (spectrum.size() == maskSpectrum.size()));
+
+	count++;
+
+#ifdef AIA_FFT_OPENCV
+	mulSpectrums(spectrum, maskSpectrum, work, 0, true);
+	cv::dft(work, work, DFT_INVERSE);
+#else
+	CV_Assert((workDepth == CV_32F) || (workDepth == CV_64F));
+	if (workDepth == CV_64F) {
+		inverseProduct<double>(spectrum, maskSpectrum, work);
+	}
+	else {
+		inverseProduct<float>(spectrum, maskSpectrum, work);
+	}
+#endif
+}
+
+// conjugate product in working precision T, inversely transformed
+template <typename T>
+void Fft::inverseProduct(const Mat& spectrum, const Mat& maskSpectrum, Mat& work) {
+
+	work.create(spectrum.rows, spectrum.cols, CV_MAKETYPE((sizeof(T) == sizeof(double)) ? CV_64F : CV_32F, 2));
+
+	for (int y = 0; y < spectrum.rows; y++) {
+		const complex<float>* a = spectrum.ptr< complex<float> >(y);
+		const complex<float>* b = maskSpectrum.ptr< complex<float> >(y);
+		complex<T>* w = work.ptr< complex<T> >(y);
+		for (int x = 0; x < spectrum.cols; x++) {
+			w[x] = complex<T>(a[x].real(), a[x].imag()) * complex<T>(b[x].real(), -b[x].imag());
+		}
+	}
+
+	transform2D<T, T, T>(work, work, work, true, 1.);
+}
+
+// transformation of a matrix in two passes
+/*
+rows are transformed from src into data, then columns from data into dst, each pass in parallel for large matrices
+src:		real or complex input of depth S
+data:		complex matrix of working precision T, same size as src; may be src
+dst:		output of depth D, complex or (one channel) real part only; may be data
+inverse:	direction of the transformation
+gain:		factor of the output, e.g. for scaling
+*/
+template <typename S, typename T, typename D>
+void Fft::transform2D(const Mat& src, Mat& data, Mat& dst, bool inverse, double gain) {
+
+	bool parallel = data.total() >= parallelSize;
+
+	// rows, then columns
+	FftRowsBody<S, T> rows(src, data, plan(data.cols, inverse));
+	if (parallel) {
+		parallel_for_(Range(0, data.rows), rows);
+	}
+	else {
+		rows(Range(0, data.rows));
+	}
+	FftColumnsBody<T, D> columns(data, dst, plan(data.rows, inverse), (T)gain);
+	if (parallel) {
+		parallel_for_(Range(0, data.cols), columns);
+	}
+	else {
+		columns(Range(0, data.cols));
+	}
+}
+
+// smallest size not smaller than n with prime factors 2, 3 and 5 only
+/*
+n:		the minimal size
+return:	the 2/3/5-smooth size
+*/
+int Fft::smoothSize(int n) {
+
+	for (int m = std::max(n, 1); ; m++) {
+		int r = m;
+		while (r % 2 == 0) r /= 2;
+		while (r % 3 == 0) r /= 3;
+		while (r % 5 == 0) r /= 5;
+		if (r == 1) {
+			return m;
+		}
+	}
+}
+
+// smallest 2/3/5-smooth size in both dimensions
+/*
+size:	the minimal size
+return:	the 2/3/5-smooth size
+*/
+Size Fft::smoothSize(Size size) {
+
+	return Size(smoothSize(size.width), smoothSize(size.height));
+}
+
+// removes all cached plans; must not be called while transformations are running
+void Fft::clearPlans(void) {
+
+	lock_guard<mutex> lock(plansLock);
+	plans.clear();
+}
+
+// number of transformations since the last reset
+long long Fft::getCount(void) {
+
+	return count;
+}
+
+// resets the number of transformations
+void Fft::resetCount(void) {
+
+	count = 0;
+}
+
+// returns the cached plan of a 1-D transformation, creates it if necessary
+/*
+plans are never removed during transformations, references stay valid
+n:			length of the transformation
+inverse:	direction of the transformation
+return:		the plan
+*/
+const FftPlan& Fft::plan(int n, bool inverse) {
+
+	lock_guard<mutex> lock(plansLock);
+	return cachedPlan(n, inverse);
+}
+
+// returns the cached plan of a 1-D transformation, creates it if necessary; plansLock has to be held
+const FftPlan& Fft::cachedPlan(int n, bool inverse) {
+
+	map< pair<int, bool>, FftPlan >::iterator it = plans.find(make_pair(n, inverse));
+	if (it != plans.end()) {
+		return it->second;
+	}
+
+	FftPlan& p = plans[make_pair(n, inverse)];
+	p.n = n;
+	p.inverse = inverse;
+	p.m = 0;
+	p.forward = NULL;
+	p.backward = NULL;
+
+	// large prime factors: Bluestein's algorithm, i.e. n j k = (j^2 + k^2 - (k - j)^2) / 2 turns the transformation into
+	// a cyclic convolution with the chirp, which is computed by transformations of smooth length m >= 2n - 1
+	if (largestPrimeFactor(n) > bluesteinRadix) {
+		p.m = smoothSize(2 * n - 1);
+		p.forward = &cachedPlan(p.m, false);
+		p.backward = &cachedPlan(p.m, true);
+		p.chirp.resize(n);
+		p.chirp32.resize(n);
+		vector< complex<double> > wrapped(p.m, complex<double>(0, 0));
+		for (int k = 0; k < n; k++) {
+			// k^2 modulo 2n keeps the phase exact for large k
+			double phase = (inverse ? 1 : -1) * CV_PI * (double)(((long long)k * k) % (2 * (long long)n)) / n;
+			p.chirp[k] = complex<double>(cos(phase), sin(phase));
+			p.chirp32[k] = complex<float>(p.chirp[k]);
+			wrapped[k] = conj(p.chirp[k]);
+			if (k > 0) {
+				wrapped[p.m - k] = conj(p.chirp[k]);
+			}
+		}
+		p.chirpSpectrum.resize(p.m);
+		transform(*p.forward, &wrapped[0], 1, &p.chirpSpectrum[0]);
+		p.chirpSpectrum32.resize(p.m);
+		for (int k = 0; k < p.m; k++) {
+			p.chirpSpectrum[k] /= p.m;
+			p.chirpSpectrum32[k] = complex<float>(p.chirpSpectrum[k]);
+		}
+		return p;
+	}
+
+	// twiddle factors
+	p.twiddle.resize(n);
+	p.twiddle32.resize(n);
+	for (int k = 0; k < n; k++) {
+		double phase = (inverse ? 2 : -2) * CV_PI * k / n;
+		p.twiddle[k] = complex<double>(cos(phase), sin(phase));
+		p.twiddle32[k] = complex<float>(p.twiddle[k]);
+	}
+
+	// factorization: radix 4 first, then 2, 3, 5 and remaining primes
+	int radix = 4, remaining = n;
+	int maxRadix = (int)floor(sqrt((double)n));
+	do {
+		while (remaining % radix) {
+			switch (radix) {
+				case 4: radix = 2; break;
+				case 2: radix = 3; break;
+				default: radix += 2; break;
+			}
+			if (radix > maxRadix) {
+				radix = remaining;
+			}
+		}
+		remaining /= radix;
+		p.factors.push_back(radix);
+		p.factors.push_back(remaining);
+	} while (remaining > 1);
+
+	return p;
+}
+
+// 1-D transformation (unscaled)
+/*
+plan:	plan of the transformation
+in:		first input element
+stride:	distance of consecutive input elements
+out:	plan.n consecutive output elements; must not overlap with the input
+*/
+template <typename T>
+void Fft::transform(const FftPlan& plan, const complex<T>* in, int stride, complex<T>* out) {
+
+	if (plan.n == 1) {
+		out[0] = in[0];
+		return;
+	}
+	if (plan.m > 0) {
+		bluestein(plan, in, stride, out);
+		return;
+	}
+	work(plan, out, in, 1, stride, &plan.factors[0]);
+}
+
+// 1-D transformation of a length with large prime factors (unscaled)
+/*
+the input multiplied by the chirp is convolved cyclically with the conjugated chirp; the convolution is computed by
+transformations of the smooth length plan.m, the scratch memory is kept per thread
+plan:	plan of the transformation, plan.m > 0
+in:		first input element
+stride:	distance of consecutive input elements
+out:	plan.n consecutive output elements; must not overlap with the input
+*/
+template <typename T>
+void Fft::bluestein(const FftPlan& plan, const complex<T>* in, int stride, complex<T>* out) {
+
+	static thread_local vector< complex<T> > a, b;
+	a.resize(plan.m);
+	b.resize(plan.m);
+
+	const complex<T>* w = chirp(plan, T());
+	const complex<T>* spectrum = chirpSpectrum(plan, T());
+	for (int j = 0; j < plan.n; j++) {
+		a[j] = in[j * stride] * w[j];
+	}
+	std::fill(a.begin() + plan.n, a.begin() + plan.m, complex<T>(0, 0));
+
+	// cyclic convolution, the spectrum of the chirp already contains the scaling of the inverse transformation
+	transform(*plan.forward, &a[0], 1, &b[0]);
+	for (int k = 0; k < plan.m; k++) {
+		b[k] *= spectrum[k];
+	}
+	transform(*plan.backward, &b[0], 1, &a[0]);
+
+	for (int k = 0; k < plan.n; k++) {
+		out[k] = a[k] * w[k];
+	}
+}
+
+// one stage of the recursive decimation in time
+/*
+plan:		plan of the transformation
+out:		p * m output elements of this stage
+in:			first input element of this stage
+fstride:	distance of the input elements of this stage in units of stride
+stride:		distance of consecutive input elements
+factors:	(p, m) of this stage, followed by the later stages
+*/
+template <typename T>
+void Fft::work(const FftPlan& plan, complex<T>* out, const complex<T>* in, int fstride, int stride, const int* factors) {
+
+	int p = factors[0], m = factors[1];
+
+	// sub-transformations of the p decimated sequences
+	for (int q = 0; q < p; q++) {
+		if (m == 1) {
+			out[q] = in[q * fstride * stride];
+		}
+		else {
+			work(plan, out + q * m, in + q * fstride * stride, fstride * p, stride, factors + 2);
+		}
+	}
+
+	switch (p) {
+		case 2: butterfly2(plan, out, fstride, m); break;
+		case 4: butterfly4(plan, out, fstride, m); break;
+		default: butterfly(plan, out, fstride, p, m); break;
+	}
+}
+
+// radix-2 butterflies
+template <typename T>
+void Fft::butterfly2(const FftPlan& plan, complex<T>* out, int fstride, int m) {
+
+	const complex<T>* tw = twiddles(plan, T());
+	complex<T>* out2 = out + m;
+	for (int k = 0; k < m; k++) {
+		complex<T> t = out2[k] * tw[k * fstride];
+		out2[k] = out[k] - t;
+		out[k] += t;
+	}
+}
+
+// radix-4 butterflies
+template <typename T>
+void Fft::butterfly4(const FftPlan& plan, complex<T>* out, int fstride, int m) {
+
+	const complex<T>* tw = twiddles(plan, T());
+	for (int k = 0; k < m; k++) {
+		complex<T> s0 = out[k + m] * tw[k * fstride];
+		complex<T> s1 = out[k + 2 * m] * tw[2 * k * fstride];
+		complex<T> s2 = out[k + 3 * m] * tw[3 * k * fstride];
+		complex<T> s5 = out[k] - s1;
+		out[k] += s1;
+		complex<T> s3 = s0 + s2;
+		complex<T> s4 = s0 - s2;
+		out[k + 2 * m] = out[k] - s3;
+		out[k] += s3;
+		// multiplication of s4 by -i (forward) or i (inverse)
+		complex<T> s4i = plan.inverse ? complex<T>(-s4.imag(), s4.real()) : complex<T>(s4.imag(), -s4.real());
+		out[k + m] = s5 + s4i;
+		out[k + 3 * m] = s5 - s4i;
+	}
+}
+
+// butterflies of any radix (3, 5 and remaining primes)
+template <typename T>
+void Fft::butterfly(const FftPlan& plan, complex<T>* out, int fstride, int p, int m) {
+
+	// radices above bluesteinRadix are transformed by Bluestein's algorithm
+	const complex<T>* tw = twiddles(plan, T());
+	complex<T> scratch[bluesteinRadix];
+	for (int u = 0; u < m; u++) {
+		for (int q = 0; q < p; q++) {
+			scratch[q] = out[u + q * m];
+		}
+		for (int q1 = 0; q1 < p; q1++) {
+			int k = u + q1 * m;
+			int idx = 0;
+			out[k] = scratch[0];
+			for (int q = 1; q < p; q++) {
+				idx += fstride * k;
+				if (idx >= plan.n) {
+					idx -= plan.n;
+				}
+				out[k] += scratch[q] * tw[idx];
+			}
+		}
+	}
+}
@@ -0,0 +1,143 @@
+//============================================================================
+// Name        : Fft.h
+// Author      : -
+// Version     : 1.0
+// Copyright   : -
+// Description : header file of the fourier transformation shared by the AIA assignments
+//============================================================================
+
+#ifndef AIA_FFT_H
+#define AIA_FFT_H
+
+#include <atomic>
+#include <complex>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+// the backend is selected at build time:
+// AIA_FFT_OPENCV defined:	all transformations are computed by cv::dft(..)
+// otherwise:				bundled mixed-radix transformation with cached plans and multi-threaded 2-D transformations;
+//							lengths with large prime factors are transformed by Bluestein's algorithm
+
+// precomputed factorization and twiddle factors of a 1-D transformation
+/*
+n:			length of the transformation
+inverse:	direction of the transformation
+factors:	pairs (p, m) per stage: radix p and remaining length m
+twiddle:	exp(-2 pi i k / n) for the forward, exp(2 pi i k / n) for the inverse transformation, k = 0..n-1
+twiddle32:	the twiddle factors in single precision
+m:			length of the cyclic convolution of Bluestein's algorithm, 2/3/5-smooth (0: mixed-radix transformation)
+forward:	plan of the forward transformation of length m
+backward:	plan of the inverse transformation of length m
+chirp:		exp(-pi i k^2 / n) for the forward, exp(pi i k^2 / n) for the inverse transformation, k = 0..n-1
+chirpSpectrum:	spectrum of the conjugated chirp, wrapped around to length m and divided by m
+chirp32, chirpSpectrum32:	the chirp and its spectrum in single precision
+*/
+struct FftPlan {int n; bool inverse; vector<int> factors; vector< complex<double> > twiddle; vector< complex<float> > twiddle32;
+	int m; const FftPlan* forward; const FftPlan* backward; vector< complex<double> > chirp, chirpSpectrum; vector< complex<float> > chirp32, chirpSpectrum32;};
+
+class Fft{
+
+	public:
+		// discrete fourier transformation, same interface and flags as cv::dft(..), plus the working precision
+		static void dft(const Mat& src, Mat& dst, int flags = 0, int workDepth = CV_32F);
+		// correlation of two spectra: conjugate multiplication, inverse transformation and scaled absolute real part per row
+		template <typename Row> static void correlate(const Mat& spectrum, const Mat& maskSpectrum, Mat& work, Size size, Row row, int workDepth = CV_32F);
+		// smallest size not smaller than n with prime factors 2, 3 and 5 only
+		static int smoothSize(int n);
+		static Size smoothSize(Size size);
+		// removes all cached plans
+		static void clearPlans(void);
+		// number of transformations since the last reset, e.g. for benchmarks
+		static long long getCount(void);
+		static void resetCount(void);
+
+	private:
+		template <typename S, typename T> friend class FftRowsBody;
+		template <typename T, typename D> friend class FftColumnsBody;
+
+		// conjugate product of two spectra, inversely transformed (unscaled) in the working buffer
+		static void inverseProduct(const Mat& spectrum, const Mat& maskSpectrum, Mat& work, int workDepth);
+		template <typename T> static void inverseProduct(const Mat& spectrum, const Mat& maskSpectrum, Mat& work);
+		// scaled absolute real part of the working buffer of working precision T, row by row
+		template <typename T, typename Row> static void correlationRows(Mat& work, Size size, Row row);
+		// transformation of a matrix of depth S in working precision T into a matrix of depth D
+		template <typename S, typename T, typename D> static void transform2D(const Mat& src, Mat& data, Mat& dst, bool inverse, double gain);
+		// returns the cached plan of a 1-D transformation, creates it if necessary
+		static const FftPlan& plan(int n, bool inverse);
+		static const FftPlan& cachedPlan(int n, bool inverse);
+		// 1-D transformation of n elements at distance stride
+		template <typename T> static void transform(const FftPlan& plan, const complex<T>* in, int stride, complex<T>* out);
+		// 1-D transformation of a length with large prime factors as a cyclic convolution
+		template <typename T> static void bluestein(const FftPlan& plan, const complex<T>* in, int stride, complex<T>* out);
+		// one stage of the recursive transformation
+		template <typename T> static void work(const FftPlan& plan, complex<T>* out, const complex<T>* in, int fstride, int stride, const int* factors);
+		// butterflies of one stage
+		template <typename T> static void butterfly2(const FftPlan& plan, complex<T>* out, int fstride, int m);
+		template <typename T> static void butterfly4(const FftPlan& plan, complex<T>* out, int fstride, int m);
+		template <typename T> static void butterfly(const FftPlan& plan, complex<T>* out, int fstride, int p, int m);
+
+		// plans keyed by length and direction
+		static map< pair<int, bool>, FftPlan > plans;
+		static mutex plansLock;
+		// number of transformations
+		static atomic<long long> count;
+};
+
+// correlation of two spectra with the inverse transformation fused into the surrounding passes
+/*
+the conjugate product is written directly into the working copy, and the absolute real part is scaled while it is read
+back; compared to mulSpectrums(..) followed by dft(..) with DFT_INVERSE | DFT_SCALE and an extraction of the real part,
+this saves the copies into and out of the working precision, the scaling pass and the complex product in between.
+the absolute real part is passed row by row, so the caller can store it or combine it with other correlations; no memory
+is allocated besides the working copy and one reused row per thread, and the row functor is inlined.
+the values passed to row(..) are only valid during the call; a caller needing them afterwards has to copy them
+spectrum:		first spectrum (CV_32FC2)
+maskSpectrum:	second spectrum, conjugated (CV_32FC2, same size as spectrum)
+work:			buffer of the working copy, reused if it has the right size and type
+size:			size of the part of the correlation to be passed, starting at the origin
+row:			called as row(y, values) for each row y < size.height with size.width absolute real parts
+workDepth:		working precision, CV_32F (as cv::dft(..)) or CV_64F
+*/
+template <typename Row>
+void Fft::correlate(const Mat& spectrum, const Mat& maskSpectrum, Mat& work, Size size, Row row, int workDepth) {
+
+	CV_Assert((size.width <= spectrum.cols) && (size.height <= spectrum.rows));
+
+	inverseProduct(spectrum, maskSpectrum, work, workDepth);
+	if (work.depth() == CV_64F) {
+		correlationRows<double>(work, size, row);
+	}
+	else {
+		correlationRows<float>(work, size, row);
+	}
+}
+
+// scaled absolute real part of the working buffer, row by row
+/*
+the values are extracted into a float row reused by the calling thread, the working copy itself is not modified
+work:	inversely transformed product (complex, working precision T)
+size:	size of the part to be passed
+row:	called for each row with size.width values
+*/
+template <typename T, typename Row>
+void Fft::correlationRows(Mat& work, Size size, Row row) {
+
+	static thread_local vector<float> line;
+	line.resize(size.width);
+	T gain = T(1) / (work.rows * work.cols);
+	for (int y = 0; y < size.height; y++) {
+		const complex<T>* w = work.ptr< complex<T> >(y);
+		for (int x = 0; x < size.width; x++) {
+			line[x] = (float)std::abs(w[x].real() * gain);
+		}
+		row(y, (const float*)line.data());
+	}
+}
+
+#endif
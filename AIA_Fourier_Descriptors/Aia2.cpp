@@ -40,7 +40,7 @@ Mat Aia2::makeFD(const Mat& contour) {
 	contour.convertTo(contour_new, CV_32FC2);
 	
 	// calculates the fourier descriptors 
-	dft(contour_new, contour_new, DFT_COMPLEX_OUTPUT);
+	Fft::dft(contour_new, contour_new, DFT_COMPLEX_OUTPUT);
 	
 	return contour_new;
 }
@@ -98,7 +98,7 @@ dur	wait number of ms or until key is pressed
 */
 void Aia2::plotFD(const Mat& fd, string win, double dur) {
 	Mat cont;
-	dft(fd, cont, DFT_INVERSE);
+	Fft::dft(fd, cont, DFT_INVERSE);
 
 	//scale 
 	normalize(cont, cont, 0, 499, CV_MINMAX);
@@ -306,6 +306,7 @@ void Aia2::test(void) {
 	test_getContourLine();
 	test_makeFD();
 	test_normFD();
+	test_fft();
 
 }
 
@@ -353,6 +354,26 @@ void Aia2::test_makeFD(void) {
 	}
 }
 
+void Aia2::test_fft(void) {
+
+	// contour lengths with radix 2, 3 and 5, a small prime and large primes (Bluestein's algorithm)
+	int lengths[] = {68, 128, 90, 91, 97, 1021};
+	RNG rng(0);
+	for (int i = 0; i < 6; i++) {
+		Mat contour(lengths[i], 1, CV_32FC2);
+		rng.fill(contour, RNG::UNIFORM, -100, 100);
+		Mat expected, fd, back;
+		dft(contour, expected, DFT_COMPLEX_OUTPUT);
+		Fft::dft(contour, fd, DFT_COMPLEX_OUTPUT);
+		Fft::dft(fd, back, DFT_INVERSE | DFT_SCALE);
+		if ((norm(fd, expected, NORM_INF) > 1e-4 * norm(expected, NORM_INF)) || (norm(back, contour, NORM_INF) > 1e-3)) {
+			cout << "There might be a problem with Fft::dft(..):" << endl;
+			cout << "\tThe fourier descriptor of " << lengths[i] << " points differs from cv::dft(..)" << endl;
+			cin.get();
+		}
+	}
+}
+
 void Aia2::test_normFD(void) {
 
 	double eps = pow(10, -3);
@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include "../AIA_Common/Fft.h"
 
 using namespace std;
 using namespace cv;
@@ -41,5 +42,6 @@ class Aia2{
 		void test_getContourLine(void);
 		void test_makeFD(void);
 		void test_normFD(void);
+		void test_fft(void);
 		
 };
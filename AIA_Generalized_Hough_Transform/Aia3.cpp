@@ -7,6 +7,23 @@
 //============================================================================
 
 #include "Aia3.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 
 // creates object template from template image
@@ -104,6 +121,181 @@ void Aia3::makeFFTObjectMask(const vector<Mat>& templ, double scale, double angl
 	//// fourier transformation
 	//dft(objectMask, fftMask, DFT_COMPLEX_OUTPUT);
 
+	HoughWorkspace ws;
+	makeFFTObjectMask(templ, scale, angle, fftMask, ws);
+}
+
+// sum of the magnitudes of a row of complex gradients
+/*
+grad:	interleaved complex gradients
+n:		number of gradients
+*/
+static double gradientMagnitude(const float* grad, int n) {
+
+	int x = 0;
+	double magnitude = 0;
+#if CV_SIMD128
+	v_float32x4 sum = v_setzero_f32();
+	for (; x <= n - 4; x += 4) {
+		v_float32x4 re, im;
+		v_load_deinterleave(grad + 2 * x, re, im);
+		sum += v_sqrt(re * re + im * im);
+	}
+	magnitude = v_reduce_sum(sum);
+#endif
+	for (; x < n; x++) {
+		magnitude += sqrt(grad[2 * x] * grad[2 * x] + grad[2 * x + 1] * grad[2 * x + 1]);
+	}
+	return magnitude;
+}
+
+// masks and rotates a row of complex gradients, i.e. multiplies them by the binary edge mask and by (c + i*s)
+/*
+edge:	binary edge mask
+grad:	interleaved complex gradients
+n:		number of gradients
+c:		real part of the factor, i.e. cosine of the angle divided by the normalization
+s:		imaginary part of the factor, i.e. sine of the angle divided by the normalization
+dst:	interleaved complex output
+*/
+static void maskGradients(const float* edge, const float* grad, int n, float c, float s, float* dst) {
+
+	int x = 0;
+#if CV_SIMD128
+	v_float32x4 vc = v_setall_f32(c), vs = v_setall_f32(s);
+	for (; x <= n - 4; x += 4) {
+		v_float32x4 re, im;
+		v_load_deinterleave(grad + 2 * x, re, im);
+		v_float32x4 e = v_load(edge + x);
+		v_store_interleave(dst + 2 * x, e * (re * vc - im * vs), e * (re * vs + im * vc));
+	}
+#endif
+	for (; x < n; x++) {
+		float re = grad[2 * x], im = grad[2 * x + 1];
+		dst[2 * x] = edge[x] * (re * c - im * s);
+		dst[2 * x + 1] = edge[x] * (re * s + im * c);
+	}
+}
+
+// view of the upper left corner of a buffer, the buffer only grows
+/*
+buffer:	the buffer, (re-)allocated if it is too small or of another type
+size:	size of the view
+type:	type of the view
+return:	the view
+*/
+static Mat bufferView(Mat& buffer, Size size, int type) {
+
+	if ((buffer.type() != type) || (buffer.rows < size.height) || (buffer.cols < size.width)) {
+		buffer.create(std::max(buffer.rows, size.height), std::max(buffer.cols, size.width), type);
+	}
+	return buffer(Rect(0, 0, size.width, size.height));
+}
+
+// prepares the spatial object mask of a workspace for a template of the given size
+/*
+the mask is zeroed completely only when it is allocated; afterwards only the footprint of the previous template is
+cleared, i.e. its rows and, within them, the columns left and right of the origin. all other elements are still zero
+spectrumSize:	size of the object mask
+maskSize:		size of the template to be written, centered at the origin
+ws:				workspace providing objectMask and the size of the previous template
+*/
+void Aia3::resetObjectMask(Size spectrumSize, Size maskSize, HoughWorkspace& ws) {
+
+	// a reallocated buffer may reuse the released address, hence the size and type are compared as well
+	const uchar* data = ws.objectMask.data;
+	bool reused = (data != NULL) && (ws.objectMask.size() == spectrumSize) && (ws.objectMask.type() == CV_32FC2);
+	ws.objectMask.create(spectrumSize, CV_32FC2);
+	if (!reused || (ws.objectMask.data != data)) {
+		ws.objectMask.setTo(Scalar::all(0));
+	}
+	else {
+		int cx = ws.maskSize.width / 2, cy = ws.maskSize.height / 2;
+		for (int y = 0; y < ws.maskSize.height; y++) {
+			Vec2f* row = ws.objectMask.ptr<Vec2f>((y - cy + ws.objectMask.rows) % ws.objectMask.rows);
+			std::fill(row, row + ws.maskSize.width - cx, Vec2f(0, 0));
+			std::fill(row + ws.objectMask.cols - cx, row + ws.objectMask.cols, Vec2f(0, 0));
+		}
+	}
+	ws.maskSize = maskSize;
+}
+
+// creates the fourier-spectrum of the scaled and rotated template without allocations
+/*
+the template is warped into buffers of the workspace, then masked, rotated and normalized row by row directly into
+its circularly shifted position (template center at the origin) of the spatial object mask of the workspace. only the
+footprint of the previous template is cleared (see resetObjectMask(..)), and the transformation reads the rows of the
+mask directly into its working precision, skipping the zero rows.
+all buffers are reused, see reserveObjectMask(..)
+templ:	the object template; binary image in templ[0], complex gradient in templ[1]
+scale:	the scale factor to scale the template
+angle:	the angle to rotate the template
+fftMask:	the generated fourier-spectrum of the template (initialized outside of this function)
+ws:		workspace providing edgeWarp, gradWarp and objectMask
+*/
+void Aia3::makeFFTObjectMask(const vector<Mat>& templ, double scale, double angle, Mat& fftMask, HoughWorkspace& ws) {
+
+	// scaled and rotated binary edge mask and complex gradients, as by rotateAndScale(..)
+	Size warpedSize;
+	Matx33f H = warpMatrix(templ[0].size(), angle, scale, warpedSize);
+	CV_Assert((warpedSize.width <= fftMask.cols) && (warpedSize.height <= fftMask.rows));
+	Mat edge = bufferView(ws.edgeWarp, warpedSize, CV_32FC1);
+	Mat grad = bufferView(ws.gradWarp, warpedSize, CV_32FC2);
+	warpPerspective(templ[0], edge, H, warpedSize, CV_INTER_LINEAR);
+	warpPerspective(templ[1], grad, H, warpedSize, CV_INTER_LINEAR);
+
+	// normalization by the sum of gradient magnitudes, which does not depend on the rotation of the gradients
+	double magnitude = 0;
+	for (int y = 0; y < grad.rows; y++) {
+		magnitude += gradientMagnitude(grad.ptr<float>(y), grad.cols);
+	}
+	float c = (float)(cos(angle) / magnitude);
+	float s = (float)(sin(angle) / magnitude);
+
+	// template center at the origin: left and right part of each row wrap around
+	resetObjectMask(fftMask.size(), grad.size(), ws);
+	int cx = grad.cols / 2, cy = grad.rows / 2;
+	for (int y = 0; y < grad.rows; y++) {
+		const float* e = edge.ptr<float>(y);
+		const float* g = grad.ptr<float>(y);
+		float* dst = ws.objectMask.ptr<float>((y - cy + ws.objectMask.rows) % ws.objectMask.rows);
+		maskGradients(e + cx, g + 2 * cx, grad.cols - cx, c, s, dst);
+		maskGradients(e, g, cx, c, s, dst + 2 * (ws.objectMask.cols - cx));
+	}
+
+	// fourier transformation
+	Fft::dft(ws.objectMask, fftMask, DFT_COMPLEX_OUTPUT, fftDepth);
+}
+
+// allocates the buffers of makeFFTObjectMask(..) in a workspace for the largest template of a list of jobs
+/*
+templ:		the object template; binary image in templ[0], complex gradient in templ[1]
+poses:		the scales and angles to be investigated
+spectrumSize:	size of the template spectra
+ws:			the workspace
+*/
+void Aia3::reserveObjectMask(const vector<Mat>& templ, const vector<HoughPose>& poses, Size spectrumSize, HoughWorkspace& ws) {
+
+	double maxScale = 0;
+	for (size_t i = 0; i < poses.size(); i++) {
+		maxScale = std::max(maxScale, poses[i].scale);
+	}
+	int side = std::min(2 * tileRadius(templ, maxScale), std::max(spectrumSize.width, spectrumSize.height));
+	bufferView(ws.edgeWarp, Size(side, side), CV_32FC1);
+	bufferView(ws.gradWarp, Size(side, side), CV_32FC2);
+	resetObjectMask(spectrumSize, Size(0, 0), ws);
+	ws.fftMask.create(spectrumSize, CV_32FC2);
+}
+
+// creates the scaled and rotated template in the spatial domain
+/*
+templ:	the object template; binary image in templ[0], complex gradient in templ[1]
+scale:	the scale factor to scale the template
+angle:	the angle to rotate the template
+objectMask:	the masked and normalized complex gradients of the transformed template (CV_32FC2, size of the transformed template)
+*/
+void Aia3::makeObjectMask(const vector<Mat>& templ, double scale, double angle, Mat& objectMask) {
+
 	// initialization of matrices
 	Mat binaryEdge = templ[0].clone();
 	Mat complexGradients = templ[1].clone();
@@ -127,8 +319,7 @@ void Aia3::makeFFTObjectMask(const vector<Mat>& templ, double scale, double angl
 
 	complexGradients /= magnitude;
 
-	// resize objectMask to the image gradient size
-	Mat objectMask = Mat::zeros(fftMask.rows, fftMask.cols, CV_32FC2);
+	objectMask.create(binaryEdge.rows, binaryEdge.cols, CV_32FC2);
 
 	// Oi*Ob component wise multiplication
 	for (int i = 0; i < binaryEdge.rows; ++i) {
@@ -138,12 +329,6 @@ void Aia3::makeFFTObjectMask(const vector<Mat>& templ, double scale, double angl
 		}
 	}
 
-	//call for the circular shift function
-	objectMask = circShift(objectMask, -binaryEdge.cols / 2, -binaryEdge.rows / 2);
-
-	// fourier transformation
-	dft(objectMask, fftMask, DFT_COMPLEX_OUTPUT);
-
 }
 
 // computes the hough space of the general hough transform
@@ -163,11 +348,12 @@ vector< vector<Mat> > Aia3::generalHough(const Mat& gradImage, const vector<Mat>
 	vector<vector<Mat>> hough;
 
 	//...convert gradImage to the frequency domain: ImageMask
-	Mat ImageMask_DFT(gradImage.rows, gradImage.cols, CV_32FC2);
-	dft(gradImage, ImageMask_DFT, DFT_COMPLEX_OUTPUT);
+	Mat ImageMask_DFT;
+	imageSpectrum(gradImage, ImageMask_DFT);
 
 	//...convert templ to frequency domain: ObjectMask
-	Mat ObjectMask_DFT(gradImage.rows, gradImage.cols, CV_32FC2);
+	Mat ObjectMask_DFT(ImageMask_DFT.rows, ImageMask_DFT.cols, CV_32FC2);
+	HoughWorkspace ws;
 
 	//...Discretization of teta by dividing the interval [0, 2pi] into A sub-intervals
 	double sub_interval_teta = 0;
@@ -197,88 +383,2192 @@ vector< vector<Mat> > Aia3::generalHough(const Mat& gradImage, const vector<Mat>
 			double angle = angleRange[0] + j * sub_interval_teta;
 
 			//
-			makeFFTObjectMask(templ, scale, angle, ObjectMask_DFT);
+			makeFFTObjectMask(templ, scale, angle, ObjectMask_DFT, ws);
 
-			//...correlation in the frequency domain
-			Mat Correlation_DFT(gradImage.rows, gradImage.cols, CV_32FC2);
-			mulSpectrums(ImageMask_DFT, ObjectMask_DFT, Correlation_DFT, 0, true);
+			//...correlation with the test image
+			Mat Correlation_DFT, result;
+			correlate(ImageMask_DFT, ObjectMask_DFT, gradImage.size(), Correlation_DFT, result);
 
-			//...correlation back to the spatial domain
-			dft(Correlation_DFT, Correlation_DFT, DFT_INVERSE | DFT_SCALE);
+			Orientation_array.push_back(result);
+		}
 
-			//
-			Mat result(Correlation_DFT.rows, Correlation_DFT.cols, CV_32FC1);
+		hough.push_back(Orientation_array);
+	}
+
+	return hough;
+}
+
+// computes the hough space of the general hough transform, reduced to maximum and argmax over scales and angles
+/*
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+houghSpace:	the reduced hough space; memory does not depend on the number of scales and angles
+*/
+void Aia3::generalHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, ReducedHough& houghSpace) {
+
+	//...convert gradImage to the frequency domain: ImageMask
+	Mat ImageMask_DFT;
+	imageSpectrum(gradImage, ImageMask_DFT);
+
+	//...one job per scale and angle
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+
+	//...fold all jobs into the reduced hough space
+	houghSweep(ImageMask_DFT, gradImage.size(), templ, poses, houghSpace);
+}
+
+// computes the reduced hough space for a given list of poses only
+/*
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles (with their grid indices) to be investigated, e.g. a subset of makeHoughPoses(..)
+houghSpace:	the reduced hough space
+*/
+void Aia3::generalHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, ReducedHough& houghSpace) {
+
+	//...convert gradImage to the frequency domain: ImageMask
+	Mat ImageMask_DFT;
+	imageSpectrum(gradImage, ImageMask_DFT);
+
+	//...fold all jobs into the reduced hough space
+	houghSweep(ImageMask_DFT, gradImage.size(), templ, poses, houghSpace);
+}
+
+// computes the reduced hough space using precomputed template spectra
+/*
+per scale and angle only one spectrum multiplication and one inverse fourier transformation are needed
+gradImage:	the gradient image of the test image; has to be of the size the bank was made for
+bank:		the template bank as generated by updateTemplateBank(..)
+houghSpace:	the reduced hough space
+*/
+void Aia3::generalHough(const Mat& gradImage, const TemplateBank& bank, ReducedHough& houghSpace) {
+
+	CV_Assert(gradImage.size() == bank.imageSize);
+
+	//...convert gradImage to the frequency domain: ImageMask
+	Mat ImageMask_DFT;
+	imageSpectrum(gradImage, ImageMask_DFT);
+
+	//...fold all jobs into the reduced hough space
+	houghSweep(ImageMask_DFT, gradImage.size(), bank.templ, bank.poses, houghSpace, &bank.spectra);
+}
 
-			//...spatial dimensions
-			for (size_t y = 0; y < gradImage.rows; y++) {
+// computes the template spectra of a template bank, one spectrum per job
+class TemplateBankBody : public ParallelLoopBody {
 
-				for (size_t x = 0; x< gradImage.cols; x++) {
+	public:
+		TemplateBankBody(Aia3* aia3, TemplateBank& bank) : aia3(aia3), bank(bank) {};
 
-					//...absolute value of the correlation matrix
-					result.at<float>(y, x) = abs(Correlation_DFT.at<Vec2f>(y, x)[0]);
+		void operator()(const Range& range) const {
+			// mask buffers are shared by all spectra of this range
+			HoughWorkspace ws;
+			aia3->reserveObjectMask(bank.templ, bank.poses, bank.imageSize, ws);
+			for (int k = range.start; k < range.end; k++) {
+				bank.spectra[k].create(bank.imageSize, CV_32FC2);
+				aia3->makeFFTObjectMask(bank.templ, bank.poses[k].scale, bank.poses[k].angle, bank.spectra[k], ws);
+			}
+		}
+
+	private:
+		Aia3* aia3;
+		TemplateBank& bank;
+};
+
+// computes the hough responses of one batch of jobs, each job in its own workspace
+class HoughSweepBody : public ParallelLoopBody {
+
+	public:
+		HoughSweepBody(Aia3* aia3, const Mat& imageSpectrum, Size imageSize, const vector<Mat>& templ, const vector<HoughPose>& poses, const vector<Mat>* spectra, int first, vector<HoughWorkspace>& workspaces)
+			: aia3(aia3), imageSpectrum(imageSpectrum), imageSize(imageSize), templ(templ), poses(poses), spectra(spectra), first(first), workspaces(workspaces) {};
+
+		void operator()(const Range& range) const {
+			for (int k = range.start; k < range.end; k++) {
+				const HoughPose& pose = poses[first + k];
+				HoughWorkspace& ws = workspaces[k];
+				if (spectra) {
+					// precomputed template spectrum
+					aia3->correlate(imageSpectrum, (*spectra)[first + k], imageSize, ws.spectrum, ws.result);
+				}
+				else {
+					aia3->makeFFTObjectMask(templ, pose.scale, pose.angle, ws.fftMask, ws);
+					aia3->correlate(imageSpectrum, ws.fftMask, imageSize, ws.spectrum, ws.result);
 				}
+			}
+		}
 
+	private:
+		Aia3* aia3;
+		const Mat& imageSpectrum;
+		Size imageSize;
+		const vector<Mat>& templ;
+		const vector<HoughPose>& poses;
+		const vector<Mat>* spectra;
+		int first;
+		vector<HoughWorkspace>& workspaces;
+};
+
+// computes the votes of one batch of jobs, each job in its own workspace
+class HoughVoteBody : public ParallelLoopBody {
+
+	public:
+		HoughVoteBody(Aia3* aia3, Size imageSize, const RTable& edges, const vector<Mat>& templ, const vector<HoughPose>& poses, int first, vector<HoughWorkspace>& workspaces)
+			: aia3(aia3), imageSize(imageSize), edges(edges), templ(templ), poses(poses), first(first), workspaces(workspaces) {};
+
+		void operator()(const Range& range) const {
+			for (int k = range.start; k < range.end; k++) {
+				const HoughPose& pose = poses[first + k];
+				HoughWorkspace& ws = workspaces[k];
+				// r-table of the scaled and rotated template
+				Mat objectMask;
+				RTable rTable;
+				aia3->makeObjectMask(templ, pose.scale, pose.angle, objectMask);
+				aia3->makeRTable(objectMask, 0, true, rTable);
+				ws.result.create(imageSize.height, imageSize.width, CV_32FC1);
+				aia3->vote(edges, rTable, ws.result);
 			}
+		}
 
-			Orientation_array.push_back(result);
+	private:
+		Aia3* aia3;
+		Size imageSize;
+		const RTable& edges;
+		const vector<Mat>& templ;
+		const vector<HoughPose>& poses;
+		int first;
+		vector<HoughWorkspace>& workspaces;
+};
+
+// computes the complex correlations of the test image with circular harmonics, one harmonic per job
+class HarmonicBody : public ParallelLoopBody {
+
+	public:
+		HarmonicBody(Aia3* aia3, const Mat& imageSpectrum, const vector<Mat>& harmonics, vector<HoughWorkspace>& workspaces)
+			: aia3(aia3), imageSpectrum(imageSpectrum), harmonics(harmonics), workspaces(workspaces) {};
+
+		void operator()(const Range& range) const {
+			for (int k = range.start; k < range.end; k++) {
+				HoughWorkspace& ws = workspaces[k];
+				// harmonic centered at the origin, as the object mask in makeFFTObjectMask(..); the mask buffer of the
+				// workspace is reused for all harmonics and scales
+				const Mat& harmonic = harmonics[k];
+				aia3->resetObjectMask(imageSpectrum.size(), harmonic.size(), ws);
+				int cx = harmonic.cols / 2, cy = harmonic.rows / 2;
+				for (int y = 0; y < harmonic.rows; y++) {
+					const Vec2f* src = harmonic.ptr<Vec2f>(y);
+					Vec2f* dst = ws.objectMask.ptr<Vec2f>((y - cy + ws.objectMask.rows) % ws.objectMask.rows);
+					memcpy(dst, src + cx, (harmonic.cols - cx) * sizeof(Vec2f));
+					memcpy(dst + ws.objectMask.cols - cx, src, cx * sizeof(Vec2f));
+				}
+				Fft::dft(ws.objectMask, ws.fftMask, DFT_COMPLEX_OUTPUT, aia3->fftDepth);
+				// complex correlation, both real and imaginary part are needed
+				mulSpectrums(imageSpectrum, ws.fftMask, ws.spectrum, 0, true);
+				Fft::dft(ws.spectrum, ws.spectrum, DFT_INVERSE | DFT_SCALE, aia3->fftDepth);
+			}
 		}
 
-		hough.push_back(Orientation_array);
+	private:
+		Aia3* aia3;
+		const Mat& imageSpectrum;
+		const vector<Mat>& harmonics;
+		vector<HoughWorkspace>& workspaces;
+};
+
+// computes the hough responses of a list of jobs in parallel and folds them into the reduced hough space
+/*
+jobs are processed in batches of one job per thread; each batch is merged in job order,
+hence the result is identical to processing the jobs one after another
+imageSpectrum:	fourier-spectrum of the gradient image of the test image, as computed by imageSpectrum(..)
+imageSize:		size of the gradient image; the hough responses are cropped to it
+templ:			the template consisting of binary image and complex-valued directional gradient image
+poses:			the jobs, i.e. scales and angles (with their grid indices) to be investigated
+houghSpace:		the reduced hough space
+spectra:		optional precomputed template spectra, one per job (see TemplateBank)
+*/
+void Aia3::houghSweep(const Mat& imageSpectrum, Size imageSize, const vector<Mat>& templ, const vector<HoughPose>& poses, ReducedHough& houghSpace, const vector<Mat>* spectra) {
+
+	// reset reduced hough space
+	houghSpace = ReducedHough();
+
+	// one workspace per concurrent job, reused for all batches
+	int batchSize = std::max(getNumThreads(), 1);
+	if (maxJobs > 0) {
+		batchSize = std::min(batchSize, maxJobs);
+	}
+	vector<HoughWorkspace> workspaces(batchSize);
+	if (!spectra) {
+		for (int k = 0; k < batchSize; k++) {
+			reserveObjectMask(templ, poses, imageSpectrum.size(), workspaces[k]);
+		}
 	}
 
-	return hough;
+	// one job at a time: the responses are folded into the hough space while they are extracted
+	if (batchSize == 1) {
+		HoughWorkspace& ws = workspaces[0];
+		for (int k = 0; k < (int)poses.size(); k++) {
+			if (!spectra) {
+				makeFFTObjectMask(templ, poses[k].scale, poses[k].angle, ws.fftMask, ws);
+			}
+			correlateHough(imageSpectrum, spectra ? (*spectra)[k] : ws.fftMask, imageSize, ws.spectrum, poses[k].scaleIdx, poses[k].angleIdx, houghSpace);
+		}
+		return;
+	}
+
+	for (int first = 0; first < (int)poses.size(); first += batchSize) {
+
+		int n = std::min(batchSize, (int)poses.size() - first);
+
+		// correlations of this batch in parallel
+		parallel_for_(Range(0, n), HoughSweepBody(this, imageSpectrum, imageSize, templ, poses, spectra, first, workspaces), n);
+
+		// merge in fixed order
+		for (int k = 0; k < n; k++) {
+			accumulateHough(workspaces[k].result, poses[first + k].scaleIdx, poses[first + k].angleIdx, houghSpace);
+		}
+	}
+}
+
+// discretizes the scale- and angle-dimension of the hough space into a list of jobs
+/*
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+poses:		the jobs in the order of the full hough space, i.e. over scales and then over angles
+*/
+void Aia3::makeHoughPoses(double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, vector<HoughPose>& poses) {
+
+	//...discretization of scale and angle, same as for the full hough space
+	double sub_interval_teta = (angleRange[1] - angleRange[0]) / angleSteps;
+	double sub_interval_scale = (scaleRange[1] - scaleRange[0]) / scaleSteps;
+
+	poses.clear();
+	for (int i = 0; i < scaleSteps; i++) {
+		for (int j = 0; j < angleSteps; j++) {
+			HoughPose pose;
+			pose.scale = scaleRange[0] + i * sub_interval_scale;
+			pose.angle = angleRange[0] + j * sub_interval_teta;
+			pose.scaleIdx = i;
+			pose.angleIdx = j;
+			poses.push_back(pose);
+		}
+	}
 }
 
+// checks the discretization of scale and angle for makeHoughPoses(..)
+/*
+scaleSteps:	scale resolution, at least one step
+scaleRange:	range of scales [min, max], 0 < min <= max
+angleSteps:	angle resolution, at least one step
+angleRange:	range of angles [min, max), min < max
+return:		description of the first invalid parameter, empty if all are valid
+*/
+string Aia3::checkHoughPoses(double scaleSteps, double* scaleRange, double angleSteps, double* angleRange) {
 
+	if (!(scaleSteps >= 1) || !(angleSteps >= 1)) {
+		return "number of scale and angle steps has to be at least 1";
+	}
+	if (!(scaleRange[0] > 0) || !(scaleRange[0] <= scaleRange[1])) {
+		return "scale range has to be positive and not inverted";
+	}
+	if (!(angleRange[0] < angleRange[1])) {
+		return "angle range must not be empty";
+	}
+	return "";
+}
 
-// shows hough space, eg. as a projection of angle- and scale-dimensions down to a single image
+// computes the fourier-spectra of a template for all poses, unless they are already available
 /*
-houghSpace:	the hough space as generated by generalHough(..)
+templ:		the template consisting of binary image and complex-valued directional gradient image
+imageSize:	size of the test images
+poses:		the scales and angles to be investigated
+bank:		the template bank; only rebuilt if template, image size or poses differ from the stored ones
+return:		true if the bank was rebuilt
 */
-void Aia3::plotHough(const vector< vector<Mat> >& houghSpace) {
+bool Aia3::updateTemplateBank(const vector<Mat>& templ, Size imageSize, const vector<HoughPose>& poses, TemplateBank& bank) {
 
-	Mat Spacehough = Mat::zeros(houghSpace.at(0).at(0).rows, houghSpace.at(0).at(0).cols, CV_32FC1);
+	// check if the stored spectra can be reused
+	bool valid = (bank.imageSize == imageSize) && (bank.templ.size() == templ.size()) && (bank.poses.size() == poses.size());
+	for (size_t i = 0; valid && (i < templ.size()); i++) {
+		valid = (bank.templ[i].size() == templ[i].size()) && (bank.templ[i].type() == templ[i].type()) && (norm(bank.templ[i], templ[i], NORM_INF) == 0);
+	}
+	for (size_t k = 0; valid && (k < poses.size()); k++) {
+		valid = (bank.poses[k].scale == poses[k].scale) && (bank.poses[k].angle == poses[k].angle);
+	}
+	if (valid) {
+		return false;
+	}
 
-	// loop over all dimensions
-	for (int scale = 0; scale < houghSpace.size(); ++scale) {
-		for (int orientation = 0; orientation < houghSpace.at(scale).size(); ++orientation) {
-			Mat fixed = houghSpace.at(scale).at(orientation);
-			for (int i = 0; i < fixed.rows; ++i) {
-				for (int j = 0; j < fixed.cols; ++j) {
+	// keep own copy of the template, the caller might change it
+	bank.templ.clear();
+	for (size_t i = 0; i < templ.size(); i++) {
+		bank.templ.push_back(templ[i].clone());
+	}
+	bank.imageSize = imageSize;
+	bank.poses = poses;
+	bank.spectra.assign(poses.size(), Mat());
 
-					Spacehough.at<float>(i, j) += fixed.at<float>(i, j);
+	// compute all spectra in parallel, each job writes its own spectrum
+	parallel_for_(Range(0, (int)poses.size()), TemplateBankBody(this, bank));
+
+	return true;
+}
+
+// computes the reduced hough space coarse-to-fine on an image pyramid
+/*
+all poses are searched on the coarsest level only; on each finer level only small windows around the candidates
+of the previous level are searched, restricted to the neighboring scales and angles of the candidate pose
+testImage:	the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+sigma:		standard deviation of directional gradient kernel
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+levels:		number of pyramid levels above the full resolution; reduced if the template gets too small
+objThresh:	relative threshold for maxima in hough space; candidates are accepted with a lower threshold
+houghSpace:	the reduced hough space of the full resolution image; zero outside of the searched windows
+*/
+void Aia3::pyramidHough(const Mat& testImage, const vector<Mat>& templ, double sigma, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, int levels, double objThresh, ReducedHough& houghSpace) {
+
+	// candidates are accepted with a lower threshold in order to not miss objects on coarse levels
+	double candThresh = 0.8 * objThresh;
+	// positions are searched within +/- searchRadius pixels around the candidate of the previous level
+	int searchRadius = 4;
+
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+
+	// the template should not be smaller than 8 pixels on the coarsest level
+	double minSize = std::min(templ[0].rows, templ[0].cols) * scaleRange[0];
+	while ((levels > 0) && (minSize / (1 << levels) < 8)) {
+		levels--;
+	}
+
+	// radius of the template at the largest scale
+	double templRadius = 0.5 * sqrt((double)templ[0].rows * templ[0].rows + templ[0].cols * templ[0].cols) * scaleRange[1] + 1;
+
+	// angles wrap around if the whole circle is investigated
+	bool periodic = fabs(angleRange[1] - angleRange[0] - 2 * CV_PI) < 1e-6;
+
+	// image pyramid
+	vector<Mat> pyramid(1, testImage);
+	for (int l = 1; l <= levels; l++) {
+		Mat down;
+		pyrDown(pyramid[l - 1], down);
+		pyramid.push_back(down);
+	}
+
+	// coarsest level: all poses, scaled down to the level
+	double f = 1. / (1 << levels);
+	vector<HoughPose> levelPoses = poses;
+	for (size_t k = 0; k < levelPoses.size(); k++) {
+		levelPoses[k].scale *= f;
+	}
+	Mat gradImage = calcDirectionalGrad(pyramid[levels], sigma);
+	Mat spectrum;
+	imageSpectrum(gradImage, spectrum);
+	houghSweep(spectrum, gradImage.size(), templ, levelPoses, houghSpace);
+	if (levels == 0) {
+		return;
+	}
+
+	vector<Scalar> candidates;
+	findHoughMaxima(houghSpace, candThresh, candidates);
+
+	// finer levels: windows around candidates
+	for (int l = levels - 1; l >= 0; l--) {
+
+		f = 1. / (1 << l);
+		gradImage = calcDirectionalGrad(pyramid[l], sigma);
+		initHough(gradImage.size(), houghSpace);
+
+		// image is periodically extended, as assumed by the circular correlation on the whole image
+		int radius = (int)ceil(templRadius * f);
+		int border = radius + searchRadius;
+		Mat extended;
+		copyMakeBorder(gradImage, extended, border, border, border, border, BORDER_WRAP);
+
+		for (size_t c = 0; c < candidates.size(); c++) {
+
+			// candidate position on this level
+			int cx = 2 * (int)candidates[c].val[2];
+			int cy = 2 * (int)candidates[c].val[3];
+
+			// neighboring scales and angles of the candidate pose
+			vector<HoughPose> band;
+			for (int ds = -1; ds <= 1; ds++) {
+				int i = (int)candidates[c].val[0] + ds;
+				if ((i < 0) || (i >= scaleSteps)) {
+					continue;
+				}
+				for (int da = -1; da <= 1; da++) {
+					int j = (int)candidates[c].val[1] + da;
+					if (periodic) {
+						j = (j + (int)angleSteps) % (int)angleSteps;
+					}
+					else if ((j < 0) || (j >= angleSteps)) {
+						continue;
+					}
+					HoughPose pose = poses[i * (int)angleSteps + j];
+					pose.scale *= f;
+					band.push_back(pose);
 				}
 			}
+
+			// window: search region plus template radius, so that the correlation is not affected by wrap-around
+			// (upper left corner cx - border in image coordinates is cx in the extended image)
+			Mat windowGrad = extended(Rect(cx, cy, 2 * border + 1, 2 * border + 1)).clone();
+
+			ReducedHough windowSpace;
+			imageSpectrum(windowGrad, spectrum);
+			houghSweep(spectrum, windowGrad.size(), templ, band, windowSpace);
+
+			// only the search region is valid
+			mergeHough(windowSpace, Rect(radius, radius, 2 * searchRadius + 1, 2 * searchRadius + 1), Point(cx - searchRadius, cy - searchRadius), houghSpace);
+		}
+
+		if (l > 0) {
+			candidates.clear();
+			findHoughMaxima(houghSpace, candThresh, candidates);
 		}
 	}
+}
 
+// computes the reduced hough space by adaptive refinement of the scale/angle-grid
+/*
+first only every 2^levels-th scale and angle is investigated; then the grid step is halved repeatedly and only the
+neighbors of the best cells (scale/angle combinations) are investigated, until the step is one bin.
+all investigated poses lie on the full grid, hence indices and object list are the same as for the full grid.
+the response of a cell is the maximal hough response at positions where this cell is the best pose.
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+scaleSteps:	scale resolution (of the finest grid)
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution (of the finest grid)
+angleRange:	range of investigated angles [min, max)
+levels:		number of refinement steps; the coarsest grid step is 2^levels bins
+numCells:	number of best cells refined in each step
+houghSpace:	the reduced hough space; positions keep the best of all investigated poses
+*/
+void Aia3::adaptiveHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, int levels, int numCells, ReducedHough& houghSpace) {
+
+	int S = (int)scaleSteps, A = (int)angleSteps;
+	bool periodic = fabs(angleRange[1] - angleRange[0] - 2 * CV_PI) < 1e-6;
+
+	vector<HoughPose> grid;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, grid);
+
+	Mat spectrum;
+	imageSpectrum(gradImage, spectrum);
+	initHough(gradImage.size(), houghSpace);
+
+	// coarse grid
+	int stride = 1 << levels;
+	vector<bool> evaluated(grid.size(), false);
+	vector<float> peak(grid.size(), 0);
+	vector<HoughPose> poses;
+	for (int i = 0; i < S; i += stride) {
+		for (int j = 0; j < A; j += stride) {
+			poses.push_back(grid[i * A + j]);
+		}
+	}
 
-	showImage(Spacehough, "Hough Space", 0);
-	Mat tempImage;
-	normalize(Spacehough, tempImage, 0, 255, CV_MINMAX);
-	tempImage.convertTo(tempImage, CV_8UC1);
-	imwrite("hough_space.png", tempImage);
+	while (true) {
+
+		// investigate the poses of this step; all neighbors may have been evaluated already (e.g. when they wrap
+		// around a short periodic angle range), then the empty hough space of the sweep is not merged
+		if (!poses.empty()) {
+			ReducedHough part;
+			houghSweep(spectrum, gradImage.size(), templ, poses, part);
+			mergeHough(part, Rect(0, 0, gradImage.cols, gradImage.rows), Point(0, 0), houghSpace);
+			for (size_t k = 0; k < poses.size(); k++) {
+				evaluated[poses[k].scaleIdx * A + poses[k].angleIdx] = true;
+			}
+
+			// response of each cell
+			for (int y = 0; y < part.maxImage.rows; y++) {
+				for (int x = 0; x < part.maxImage.cols; x++) {
+					int cell = (int)part.scaleIdx.at<float>(y, x) * A + (int)part.angleIdx.at<float>(y, x);
+					peak[cell] = std::max(peak[cell], part.maxImage.at<float>(y, x));
+				}
+			}
+		}
+
+		if (stride == 1) {
+			break;
+		}
+		stride /= 2;
+
+		// best cells so far
+		vector< pair<float, int> > ranking;
+		for (size_t c = 0; c < grid.size(); c++) {
+			if (evaluated[c]) {
+				ranking.push_back(make_pair(-peak[c], (int)c));
+			}
+		}
+		sort(ranking.begin(), ranking.end());
+
+		// their neighbors on the refined grid
+		vector<bool> selected(grid.size(), false);
+		for (int r = 0; r < std::min(numCells, (int)ranking.size()); r++) {
+			int i0 = ranking[r].second / A, j0 = ranking[r].second % A;
+			for (int di = -1; di <= 1; di++) {
+				int i = i0 + di * stride;
+				if ((i < 0) || (i >= S)) {
+					continue;
+				}
+				for (int dj = -1; dj <= 1; dj++) {
+					int j = j0 + dj * stride;
+					if (periodic) {
+						j = (j % A + A) % A;
+					}
+					else if ((j < 0) || (j >= A)) {
+						continue;
+					}
+					if (!evaluated[i * A + j]) {
+						selected[i * A + j] = true;
+					}
+				}
+			}
+		}
+		poses.clear();
+		for (size_t c = 0; c < grid.size(); c++) {
+			if (selected[c]) {
+				poses.push_back(grid[c]);
+			}
+		}
+	}
 }
 
+// decomposes a template into circular harmonics
+/*
+in polar coordinates around the template center the template is O(r, phi) = sum_n O_n(r) exp(i n phi); the radial
+profiles O_n(r) are averaged over rings of one pixel width. the harmonics with most energy are kept.
+objectMask:	masked and normalized complex gradients of the template as computed by makeObjectMask(..)
+numHarmonics:	number of harmonics to keep
+harmonics:	the harmonics O_n(r) exp(i n phi) (CV_32FC2, size of objectMask)
+orders:		the order n of each harmonic
+*/
+void Aia3::circularHarmonics(const Mat& objectMask, int numHarmonics, vector<Mat>& harmonics, vector<int>& orders) {
+
+	int cx = objectMask.cols / 2;
+	int cy = objectMask.rows / 2;
+	int maxOrder = numHarmonics;
+	int nOrders = 2 * maxOrder + 1;
+	int nRings = cvRound(sqrt((double)objectMask.cols * objectMask.cols + objectMask.rows * objectMask.rows)) + 1;
+
+	// ring index and angle of each pixel
+	Mat ring(objectMask.rows, objectMask.cols, CV_32SC1), phi(objectMask.rows, objectMask.cols, CV_32FC1);
+	vector<int> count(nRings, 0);
+	for (int y = 0; y < objectMask.rows; y++) {
+		for (int x = 0; x < objectMask.cols; x++) {
+			double dx = x - cx, dy = y - cy;
+			ring.at<int>(y, x) = cvRound(sqrt(dx * dx + dy * dy));
+			phi.at<float>(y, x) = atan2(dy, dx);
+			count[ring.at<int>(y, x)]++;
+		}
+	}
 
+	// radial profiles: coef[n][r] = mean over ring r of O * exp(-i n phi)
+	vector< vector<Vec2d> > coef(nOrders, vector<Vec2d>(nRings, Vec2d(0, 0)));
+	for (int y = 0; y < objectMask.rows; y++) {
+		for (int x = 0; x < objectMask.cols; x++) {
+			Vec2f o = objectMask.at<Vec2f>(y, x);
+			if ((o[0] == 0) && (o[1] == 0)) {
+				continue;
+			}
+			int r = ring.at<int>(y, x);
+			for (int k = 0; k < nOrders; k++) {
+				double a = -(k - maxOrder) * phi.at<float>(y, x);
+				coef[k][r][0] += (o[0] * cos(a) - o[1] * sin(a)) / count[r];
+				coef[k][r][1] += (o[0] * sin(a) + o[1] * cos(a)) / count[r];
+			}
+		}
+	}
 
-/* *****************************
-GIVEN FUNCTIONS
-***************************** */
+	// keep the orders with the largest energy
+	vector< pair<double, int> > energy;
+	for (int k = 0; k < nOrders; k++) {
+		double e = 0;
+		for (int r = 0; r < nRings; r++) {
+			e += count[r] * (coef[k][r][0] * coef[k][r][0] + coef[k][r][1] * coef[k][r][1]);
+		}
+		energy.push_back(make_pair(-e, k));
+	}
+	sort(energy.begin(), energy.end());
+
+	harmonics.clear();
+	orders.clear();
+	for (int h = 0; h < std::min(numHarmonics, nOrders); h++) {
+		int k = energy[h].second;
+		int n = k - maxOrder;
+		Mat harmonic(objectMask.rows, objectMask.cols, CV_32FC2);
+		for (int y = 0; y < objectMask.rows; y++) {
+			for (int x = 0; x < objectMask.cols; x++) {
+				const Vec2d& c = coef[k][ring.at<int>(y, x)];
+				double a = n * phi.at<float>(y, x);
+				harmonic.at<Vec2f>(y, x) = Vec2f(c[0] * cos(a) - c[1] * sin(a), c[0] * sin(a) + c[1] * cos(a));
+			}
+		}
+		harmonics.push_back(harmonic);
+		orders.push_back(n);
+	}
+}
 
-// loads template and test images, sets parameters and calls processing routine
+// follows tracked objects from the previous frame to the current one
 /*
-tmplImg:	path to template image
-testImg:	path to test image
+each object is searched only within searchRadius pixels around its last position and within poseBand scale and
+angle steps around its last pose. an object is found if its response is at least objThresh times the response
+of its last detection; otherwise it keeps its last pose and is marked as lost.
+gradImage:		the gradient image of the current frame
+templ:			the template consisting of binary image and complex-valued directional gradient image
+poses:			all scales and angles of the hough space, as generated by makeHoughPoses(..)
+scaleSteps:		scale resolution
+angleSteps:		angle resolution
+periodic:		whether the angle range covers the full circle
+searchRadius:	maximal movement in pixels between two frames
+poseBand:		maximal change of scale and angle in steps between two frames
+objThresh:		relative threshold with respect to the last response of the object
+tracks:			the tracked objects, updated to the current frame
+return:			whether all objects were found
 */
-void Aia3::run(string tmplImg, string testImg) {
+bool Aia3::trackHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double scaleSteps, double angleSteps, bool periodic, int searchRadius, int poseBand, double objThresh, vector<HoughTrack>& tracks) {
+
+	bool found = true;
+	for (size_t t = 0; t < tracks.size(); t++) {
+
+		HoughTrack& track = tracks[t];
+
+		// neighboring scales and angles of the last pose
+		vector<HoughPose> band;
+		for (int ds = -poseBand; ds <= poseBand; ds++) {
+			int i = (int)track.pose.val[0] + ds;
+			if ((i < 0) || (i >= scaleSteps)) {
+				continue;
+			}
+			for (int da = -poseBand; da <= poseBand; da++) {
+				int j = (int)track.pose.val[1] + da;
+				if (periodic) {
+					j = (j + (int)angleSteps) % (int)angleSteps;
+				}
+				else if ((j < 0) || (j >= angleSteps)) {
+					continue;
+				}
+				band.push_back(poses[i * (int)angleSteps + j]);
+			}
+		}
+
+		// search window around the last position
+		Point center((int)track.pose.val[2], (int)track.pose.val[3]);
+		ReducedHough windowSpace;
+		localHough(gradImage, templ, band, center, searchRadius, windowSpace);
+
+		double minVal, maxVal;
+		Point peak;
+		minMaxLoc(windowSpace.maxImage, &minVal, &maxVal, 0, &peak);
+		if (maxVal < objThresh * track.score) {
+			track.lost = true;
+			found = false;
+			continue;
+		}
+
+		// new pose, position is kept within the image
+		track.pose.val[0] = windowSpace.scaleIdx.at<float>(peak);
+		track.pose.val[1] = windowSpace.angleIdx.at<float>(peak);
+		track.pose.val[2] = std::min(std::max(center.x + peak.x - searchRadius, 0), gradImage.cols - 1);
+		track.pose.val[3] = std::min(std::max(center.y + peak.y - searchRadius, 0), gradImage.rows - 1);
+		track.score = maxVal;
+		track.lost = false;
+	}
+
+	return found;
+}
+
+// computes the reduced hough space within a small search region only
+/*
+the correlation is computed on a window of the search region plus the template radius, hence it is not affected
+by wrap-around; beyond its borders the image is continued periodically, as for the correlation of the whole image
+gradImage:		the gradient image of the test image
+templ:			the template consisting of binary image and complex-valued directional gradient image
+poses:			the scales and angles to be investigated
+center:			center of the search region
+searchRadius:	the search region covers center +- searchRadius in both directions
+houghSpace:		the reduced hough space of the search region, position (searchRadius, searchRadius) is the center
+*/
+void Aia3::localHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, Point center, int searchRadius, ReducedHough& houghSpace) {
+
+	// radius of the template at the largest investigated scale
+	double maxScale = 0;
+	for (size_t k = 0; k < poses.size(); k++) {
+		maxScale = std::max(maxScale, poses[k].scale);
+	}
+	int radius = tileRadius(templ, maxScale);
+	int border = radius + searchRadius;
+
+	Mat window(2 * border + 1, 2 * border + 1, gradImage.type());
+	wrapCopy(gradImage, Point(center.x - border, center.y - border), window);
+
+	Mat spectrum;
+	ReducedHough windowSpace;
+	imageSpectrum(window, spectrum);
+	houghSweep(spectrum, window.size(), templ, poses, windowSpace);
+
+	// only the search region is valid
+	Rect valid(radius, radius, 2 * searchRadius + 1, 2 * searchRadius + 1);
+	houghSpace.maxImage = windowSpace.maxImage(valid);
+	houghSpace.sumImage = windowSpace.sumImage(valid);
+	houghSpace.scaleIdx = windowSpace.scaleIdx(valid);
+	houghSpace.angleIdx = windowSpace.angleIdx(valid);
+}
+
+// computes the reduced hough space with circular harmonics for the angle dimension
+/*
+rotating the template by theta (positions and gradient directions) multiplies harmonic n by exp(i (1-n) theta); hence the
+correlation for any angle is a weighted sum of the (complex) correlations with the harmonics, which are computed once
+per scale. the costs per angle are a few multiplications per pixel instead of fourier transformations.
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles to be investigated, in the order of makeHoughPoses(..)
+numHarmonics:	number of harmonics per scale
+houghSpace:	the reduced hough space
+*/
+void Aia3::harmonicHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, int numHarmonics, ReducedHough& houghSpace) {
+
+	houghSpace = ReducedHough();
+
+	Mat spectrum;
+	imageSpectrum(gradImage, spectrum);
+
+	Mat result(gradImage.rows, gradImage.cols, CV_32FC1);
+	vector<HoughWorkspace> workspaces;
+
+	// poses of one scale are consecutive
+	for (size_t first = 0; first < poses.size(); ) {
+
+		size_t last = first;
+		while ((last < poses.size()) && (poses[last].scaleIdx == poses[first].scaleIdx)) {
+			last++;
+		}
+
+		// harmonics of the unrotated template at this scale
+		Mat objectMask;
+		vector<Mat> harmonics;
+		vector<int> orders;
+		makeObjectMask(templ, poses[first].scale, 0, objectMask);
+		circularHarmonics(objectMask, numHarmonics, harmonics, orders);
+
+		// complex correlations with all harmonics, in parallel
+		workspaces.resize(harmonics.size());
+		parallel_for_(Range(0, (int)harmonics.size()), HarmonicBody(this, spectrum, harmonics, workspaces));
+
+		// synthesize the correlation for each angle
+		for (size_t k = first; k < last; k++) {
+			result.setTo(0);
+			for (size_t h = 0; h < harmonics.size(); h++) {
+				float c = cos((1 - orders[h]) * poses[k].angle);
+				float s = sin((1 - orders[h]) * poses[k].angle);
+				for (int y = 0; y < result.rows; y++) {
+					const Vec2f* corr = workspaces[h].spectrum.ptr<Vec2f>(y);
+					float* res = result.ptr<float>(y);
+					for (int x = 0; x < result.cols; x++) {
+						res[x] += c * corr[x][0] + s * corr[x][1];
+					}
+				}
+			}
+			result = abs(result);
+			accumulateHough(result, poses[k].scaleIdx, poses[k].angleIdx, houghSpace);
+		}
+
+		first = last;
+	}
+}
+
+// computes the reduced hough space tile by tile (overlap-save)
+/*
+each tile is extended by the template radius on all sides; the circular correlation of the extended tile is exact
+in the interior, hence the result is the same as for the correlation of the whole image (up to rounding), also at
+tile seams. at the image borders the image is continued periodically. the tile size only depends on the template
+size, so all transformations stay small.
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles to be investigated
+tileSize:	size of the fourier transformation per tile; 0 chooses it from the template size
+houghSpace:	the reduced hough space
+candidates:	optional mask of candidate positions (see edgeCandidates(..)); tiles without candidates are skipped and
+			all other positions are set to zero
+return:		number of correlated tiles
+*/
+int Aia3::tiledHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, int tileSize, ReducedHough& houghSpace, const Mat* candidates) {
+
+	// radius of the template at the largest investigated scale
+	double maxScale = 0;
+	for (size_t k = 0; k < poses.size(); k++) {
+		maxScale = std::max(maxScale, poses[k].scale);
+	}
+	int radius = tileRadius(templ, maxScale);
+
+	// tile size: several template footprints, but not larger than the (extended) image
+	if (tileSize <= 0) {
+		tileSize = Fft::smoothSize(std::max(8 * (2 * radius + 1), 64));
+	}
+	int tileCols = std::min(tileSize, Fft::smoothSize(gradImage.cols + 2 * radius));
+	int tileRows = std::min(tileSize, Fft::smoothSize(gradImage.rows + 2 * radius));
+	int validCols = tileCols - 2 * radius;
+	int validRows = tileRows - 2 * radius;
+	CV_Assert((validCols > 0) && (validRows > 0));
+
+	// template spectra are the same for all tiles
+	TemplateBank bank;
+	updateTemplateBank(templ, Size(tileCols, tileRows), poses, bank);
+
+	initHough(gradImage.size(), houghSpace);
+	int tiles = tileSweep(gradImage, Size(tileCols, tileRows), radius, bank.templ, bank.poses, bank.spectra, houghSpace, candidates);
+
+	if (candidates) {
+		// positions outside of the candidate regions
+		Mat background = (*candidates == 0);
+		houghSpace.maxImage.setTo(0, background);
+		houghSpace.sumImage.setTo(0, background);
+		houghSpace.scaleIdx.setTo(0, background);
+		houghSpace.angleIdx.setTo(0, background);
+	}
+	return tiles;
+}
+
+// chooses tile size, number of concurrent jobs, template bank and precision of the fourier transformations
+/*
+configurations are tried from fastest to most economical: whole image before tiles (of decreasing size), double
+before single precision, template bank before spectra on the fly; for each of them as many concurrent jobs as
+threads are available, but at least one, as long as the estimated memory stays within the limit.
+if nothing fits, the most economical configuration is returned.
+imageSize:		size of the test image
+templ:			the template consisting of binary image and complex-valued directional gradient image
+poses:			the scales and angles to be investigated
+memoryLimit:	memory cap in MB
+bankLimit:		maximal memory in MB of a template bank for the whole image
+tiled:			whether the image has to be processed tile by tile anyway
+plan:			the chosen plan
+return:			whether the plan stays within the memory limit
+*/
+bool Aia3::planHough(Size imageSize, const vector<Mat>& templ, const vector<HoughPose>& poses, double memoryLimit, double bankLimit, bool tiled, HoughPlan& plan) {
+
+	int threads = std::max(getNumThreads(), 1);
+	int numPoses = (int)poses.size();
+
+	// tile sizes: whole image, then as for tiledHough(..) and halved down to twice the template footprint
+	double maxScale = 0;
+	for (size_t k = 0; k < poses.size(); k++) {
+		maxScale = std::max(maxScale, poses[k].scale);
+	}
+	int footprint = 2 * tileRadius(templ, maxScale) + 1;
+	vector<int> tileSizes;
+	if (!tiled) {
+		tileSizes.push_back(0);
+	}
+	for (int t = std::max(8 * footprint, 64); ; t /= 2) {
+		tileSizes.push_back(Fft::smoothSize(std::max(t, 2 * footprint)));
+		if (t <= 2 * footprint) {
+			break;
+		}
+	}
+
+	double bankSize = numPoses * (double)imageSize.area() * 2 * sizeof(float) / (1024. * 1024.);
+	int depths[2] = {CV_64F, CV_32F};
+
+	for (size_t t = 0; t < tileSizes.size(); t++) {
+		for (int d = 0; d < 2; d++) {
+			for (int b = 1; b >= 0; b--) {
+				// tiles always share one bank of tile spectra
+				bool bank = (tileSizes[t] > 0) || (b == 1);
+				if ((tileSizes[t] == 0) && bank && (bankSize > bankLimit)) {
+					continue;
+				}
+				if ((tileSizes[t] > 0) && (b == 0)) {
+					continue;
+				}
+				for (int jobs = threads; jobs >= 1; jobs--) {
+					double memory = planMemory(imageSize, tileSizes[t], numPoses, jobs, bank, depths[d]);
+					if (memory <= memoryLimit) {
+						plan.tileSize = tileSizes[t];
+						plan.jobs = jobs;
+						plan.bank = bank;
+						plan.fftDepth = depths[d];
+						plan.memory = memory;
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	// most economical configuration
+	plan.tileSize = tileSizes.back();
+	plan.jobs = 1;
+	plan.bank = true;
+	plan.fftDepth = CV_32F;
+	plan.memory = planMemory(imageSize, plan.tileSize, numPoses, plan.jobs, plan.bank, plan.fftDepth);
+	return false;
+}
+
+// estimates the peak memory of the hough transform
+/*
+fixed:		gradient image and reduced hough space of the whole image, image spectrum (per tile), template bank
+per job:	template spectrum and its spatial object mask, correlation spectrum (in working precision), hough response and
+			the working copy of the forward fourier transformation
+imageSize:	size of the test image
+tileSize:	size of the fourier transformation per tile (0: whole image at once)
+numPoses:	number of scales and angles
+jobs:		number of concurrent jobs
+bank:		whether all template spectra are kept
+fftDepth:	working precision of the fourier transformations
+return:		the estimated memory in MB
+*/
+double Aia3::planMemory(Size imageSize, int tileSize, int numPoses, int jobs, bool bank, int fftDepth) {
+
+	double pixels = imageSize.area();
+	double spectrumPixels = (tileSize > 0) ? (double)tileSize * tileSize : (double)imageSize.area();
+	double responsePixels = (tileSize > 0) ? spectrumPixels : pixels;
+	double complexBytes = 2 * sizeof(float);
+	double fftBytes = (fftDepth == CV_64F) ? 2 * sizeof(double) : 2 * sizeof(float);
+
+	// gradient image and reduced hough space
+	double memory = pixels * complexBytes + pixels * 4 * sizeof(float);
+	// image spectrum, for tiles also the tile and its reduced hough space
+	memory += spectrumPixels * complexBytes;
+	if (tileSize > 0) {
+		memory += spectrumPixels * complexBytes + spectrumPixels * 4 * sizeof(float);
+	}
+	// template bank
+	if (bank) {
+		memory += numPoses * spectrumPixels * complexBytes;
+	}
+	// workspaces
+	memory += jobs * (spectrumPixels * (2 * complexBytes + 2 * fftBytes) + responsePixels * sizeof(float));
+
+	return memory / (1024. * 1024.);
+}
+
+// correlates an image tile by tile with precomputed template spectra
+/*
+gradImage:	the gradient image of the test image
+tileSize:	size of the tiles, i.e. of the fourier transformations; same as the size of the template spectra
+radius:		template radius; tiles overlap by twice the radius, only their interior is valid
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles to be investigated
+spectra:	one template spectrum of tile size per pose
+houghSpace:	the reduced hough space of the image (initialized outside of this function), each tile is merged into it
+candidates:	optional mask of candidate positions; tiles without candidates are skipped
+return:		number of correlated tiles
+*/
+int Aia3::tileSweep(const Mat& gradImage, Size tileSize, int radius, const vector<Mat>& templ, const vector<HoughPose>& poses, const vector<Mat>& spectra, ReducedHough& houghSpace, const Mat* candidates) {
+
+	int validCols = tileSize.width - 2 * radius;
+	int validRows = tileSize.height - 2 * radius;
+
+	Mat tile(tileSize.height, tileSize.width, CV_32FC2), tileSpectrum;
+	ReducedHough tileSpace;
+	int tiles = 0;
+	for (int ty = 0; ty < gradImage.rows; ty += validRows) {
+		for (int tx = 0; tx < gradImage.cols; tx += validCols) {
+
+			// only the interior of the tile is valid
+			int w = std::min(validCols, gradImage.cols - tx);
+			int h = std::min(validRows, gradImage.rows - ty);
+			if (candidates && (countNonZero((*candidates)(Rect(tx, ty, w, h))) == 0)) {
+				continue;
+			}
+
+			// extended tile, periodic continuation at image borders
+			wrapCopy(gradImage, Point(tx - radius, ty - radius), tile);
+			imageSpectrum(tile, tileSpectrum);
+			houghSweep(tileSpectrum, tile.size(), templ, poses, tileSpace, &spectra);
+
+			mergeHough(tileSpace, Rect(radius, radius, w, h), Point(tx, ty), houghSpace);
+			tiles++;
+		}
+	}
+
+	return tiles;
+}
+
+// computes the reduced hough space on an octave pyramid of the test image
+/*
+the scale range is split into octaves [s0 2^o, s0 2^(o+1)), s0 being the smallest scale; octave o is searched on the
+test image downsampled o times by a factor of 2 with the template scaled by s / 2^o only. hence all template scales
+stay within [s0, 2 s0), large scales are searched on small images, and all octaves are correlated by tiles of the
+same size, which share the template spectra of equal in-octave scale and angle (e.g. for geometric scale steps).
+positions of octave o are accurate up to 2^o pixels; only the local maxima of an octave are kept on full resolution.
+testImage:	the test image (CV_32FC1)
+templ:		the template consisting of binary image and complex-valued directional gradient image
+sigma:		standard deviation of directional gradient kernel
+poses:		the scales and angles to be investigated
+houghSpace:	the reduced hough space on full resolution
+return:		number of computed template spectra; the spectra of all other poses are shared with a lower octave
+*/
+int Aia3::octaveHough(const Mat& testImage, const vector<Mat>& templ, double sigma, const vector<HoughPose>& poses, ReducedHough& houghSpace) {
+
+	// octave of each pose
+	double minScale = poses[0].scale;
+	for (size_t k = 0; k < poses.size(); k++) {
+		minScale = std::min(minScale, poses[k].scale);
+	}
+	CV_Assert(minScale > 0);
+	vector<int> octave(poses.size());
+	int numOctaves = 1;
+	double maxInOctave = 0;
+	for (size_t k = 0; k < poses.size(); k++) {
+		octave[k] = std::max(0, (int)floor(log(poses[k].scale / minScale) / log(2.) + 1e-9));
+		numOctaves = std::max(numOctaves, octave[k] + 1);
+		maxInOctave = std::max(maxInOctave, poses[k].scale / (1 << octave[k]));
+	}
+
+	// one tile size for all octaves
+	int radius = tileRadius(templ, maxInOctave);
+	int tileSize = Fft::smoothSize(std::max(8 * (2 * radius + 1), 64));
+	Size tile(std::min(tileSize, Fft::smoothSize(testImage.cols + 2 * radius)), std::min(tileSize, Fft::smoothSize(testImage.rows + 2 * radius)));
+
+	// template spectra keyed by in-octave scale and angle, shared by all octaves
+	map< pair<long long, long long>, Mat > shared;
+
+	initHough(testImage.size(), houghSpace);
+
+	Mat image = testImage;
+	for (int o = 0; o < numOctaves; o++) {
+
+		if (o > 0) {
+			pyrDown(image, image);
+		}
+
+		// poses of this octave with in-octave scales, and their spectra
+		TemplateBank bank;
+		vector<HoughPose> octavePoses, missing;
+		for (size_t k = 0; k < poses.size(); k++) {
+			if (octave[k] == o) {
+				HoughPose pose = poses[k];
+				pose.scale /= (1 << o);
+				octavePoses.push_back(pose);
+				if (!shared.count(make_pair(llround(pose.scale * 1e6), llround(pose.angle * 1e6)))) {
+					missing.push_back(pose);
+				}
+			}
+		}
+		if (octavePoses.empty()) {
+			continue;
+		}
+		updateTemplateBank(templ, tile, missing, bank);
+		for (size_t k = 0; k < missing.size(); k++) {
+			shared[make_pair(llround(missing[k].scale * 1e6), llround(missing[k].angle * 1e6))] = bank.spectra[k];
+		}
+		vector<Mat> spectra;
+		for (size_t k = 0; k < octavePoses.size(); k++) {
+			spectra.push_back(shared[make_pair(llround(octavePoses[k].scale * 1e6), llround(octavePoses[k].angle * 1e6))]);
+		}
+
+		// correlation on the downsampled image
+		Mat gradImage = calcDirectionalGrad(image, sigma);
+		ReducedHough octaveSpace;
+		initHough(gradImage.size(), octaveSpace);
+		tileSweep(gradImage, tile, radius, templ, octavePoses, spectra, octaveSpace, NULL);
+
+		// fold the projection into full resolution: each position takes the sum of its downsampled position
+		for (int y = 0; y < houghSpace.sumImage.rows; y++) {
+			int oy = std::min(y >> o, gradImage.rows - 1);
+			for (int x = 0; x < houghSpace.sumImage.cols; x++) {
+				int ox = std::min(x >> o, gradImage.cols - 1);
+				houghSpace.sumImage.at<float>(y, x) += octaveSpace.sumImage.at<float>(oy, ox);
+			}
+		}
+
+		// fold the maxima only at the local maxima of the octave: a block of 2^o x 2^o equal responses
+		// would pass the non-maxima suppression of findHoughMaxima(..) as up to 4^o objects
+		Mat peaks;
+		if (o > 0) {
+			Mat neighborMax;
+			dilate(octaveSpace.maxImage, neighborMax, Mat::ones(3, 3, CV_8UC1));
+			peaks = (octaveSpace.maxImage >= neighborMax) & (octaveSpace.maxImage > 0);
+		}
+		for (int oy = 0; oy < octaveSpace.maxImage.rows; oy++) {
+			int y = oy << o;
+			if (y >= houghSpace.maxImage.rows) {
+				break;
+			}
+			for (int ox = 0; ox < octaveSpace.maxImage.cols; ox++) {
+				int x = ox << o;
+				if (x >= houghSpace.maxImage.cols) {
+					break;
+				}
+				if ((o > 0) && !peaks.at<uchar>(oy, ox)) {
+					continue;
+				}
+				float value = octaveSpace.maxImage.at<float>(oy, ox);
+				if (value > houghSpace.maxImage.at<float>(y, x)) {
+					houghSpace.maxImage.at<float>(y, x) = value;
+					houghSpace.scaleIdx.at<float>(y, x) = octaveSpace.scaleIdx.at<float>(oy, ox);
+					houghSpace.angleIdx.at<float>(y, x) = octaveSpace.angleIdx.at<float>(oy, ox);
+				}
+			}
+		}
+	}
+
+	return (int)shared.size();
+}
+
+// marks positions whose neighborhood contains enough edges to hold an object
+/*
+the sum of gradient magnitudes over a window of the template footprint at the largest scale is computed for all
+positions from an integral image; positions where it is below roiThresh times its maximum are background
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles to be investigated
+roiThresh:	relative threshold on the edge sum within the template footprint
+candidates:	mask of candidate positions (CV_8UC1, 255: candidate)
+*/
+void Aia3::edgeCandidates(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double roiThresh, Mat& candidates) {
+
+	// radius of the template at the largest investigated scale
+	double maxScale = 0;
+	for (size_t k = 0; k < poses.size(); k++) {
+		maxScale = std::max(maxScale, poses[k].scale);
+	}
+	int radius = tileRadius(templ, maxScale);
+
+	// integral image of the gradient magnitude
+	Mat planes[2], magn, sums;
+	split(gradImage, planes);
+	magnitude(planes[0], planes[1], magn);
+	integral(magn, sums, CV_64F);
+
+	// edge sum within the footprint around each position (clipped at the image borders)
+	Mat boxSums(gradImage.rows, gradImage.cols, CV_32FC1);
+	for (int y = 0; y < gradImage.rows; y++) {
+		int y0 = std::max(y - radius, 0), y1 = std::min(y + radius + 1, gradImage.rows);
+		const double* top = sums.ptr<double>(y0);
+		const double* bottom = sums.ptr<double>(y1);
+		float* box = boxSums.ptr<float>(y);
+		for (int x = 0; x < gradImage.cols; x++) {
+			int x0 = std::max(x - radius, 0), x1 = std::min(x + radius + 1, gradImage.cols);
+			box[x] = (float)(bottom[x1] - bottom[x0] - top[x1] + top[x0]);
+		}
+	}
+
+	double minSum, maxSum;
+	minMaxLoc(boxSums, &minSum, &maxSum);
+	candidates = (boxSums >= roiThresh * maxSum);
+}
+
+// radius of the scaled and rotated template in pixels
+/*
+templ:	the template consisting of binary image and complex-valued directional gradient image
+scale:	the scale of the template
+return:	maximal distance of a template pixel to the template center, for all angles
+*/
+int Aia3::tileRadius(const vector<Mat>& templ, double scale) {
+
+	// rotateAndScale(..) produces at most the diagonal times the scale plus one pixel
+	double diag = sqrt((double)templ[0].rows * templ[0].rows + templ[0].cols * templ[0].cols);
+	return (int)ceil(0.5 * (diag * scale + 2));
+}
+
+// copies a window of an image, which is continued periodically beyond its borders
+/*
+src:	the image
+origin:	position of the upper left corner of the window in src; may be negative or beyond the image
+dst:	the window (of the same type as src, initialized outside of this function)
+*/
+void Aia3::wrapCopy(const Mat& src, Point origin, Mat& dst) {
+
+	size_t elem = src.elemSize();
+	for (int y = 0; y < dst.rows; y++) {
+		int sy = ((origin.y + y) % src.rows + src.rows) % src.rows;
+		const uchar* in = src.ptr(sy);
+		uchar* out = dst.ptr(y);
+		// copy contiguous runs
+		int x = 0;
+		while (x < dst.cols) {
+			int sx = ((origin.x + x) % src.cols + src.cols) % src.cols;
+			int run = std::min(dst.cols - x, src.cols - sx);
+			memcpy(out + x * elem, in + sx * elem, run * elem);
+			x += run;
+		}
+	}
+}
+
+// estimates scale and rotation of the object in the test image by the fourier-mellin transform
+/*
+the magnitude spectra of template and test image do not depend on the object position; in log-polar coordinates
+rotation and scaling of the object become shifts, which are found by phase correlation.
+the magnitude spectrum is point symmetric, hence each rotation is also reported rotated by pi
+templGrad:	complex gradient of the template image (templ[1])
+gradImage:	complex gradient of the test image
+numPeaks:	number of correlation peaks to be reported
+candidates:	estimated (scale, angle) pairs, angle in radians
+*/
+void Aia3::fourierMellin(const Mat& templGrad, const Mat& gradImage, int numPeaks, vector<Vec2d>& candidates) {
+
+	// both spectra on the same square grid, otherwise rotations are distorted
+	int size = Fft::smoothSize(std::max(std::max(gradImage.rows, gradImage.cols), std::max(templGrad.rows, templGrad.cols)));
+
+	// gradient magnitudes, test image weighted by a window to suppress its borders
+	Mat planes[2], templMagn, imageMagn, window;
+	split(templGrad, planes);
+	magnitude(planes[0], planes[1], templMagn);
+	split(gradImage, planes);
+	magnitude(planes[0], planes[1], imageMagn);
+	createHanningWindow(window, imageMagn.size(), CV_32F);
+	multiply(imageMagn, window, imageMagn);
+
+	// log-polar sampling: rows are angles in [0, pi), columns log-radii in [rMin, size/2]
+	int nAngles = 360, nRadii = 256;
+	double rMin = 2, logStep = log(size / 2. / rMin) / nRadii;
+	Mat mapX(nAngles, nRadii, CV_32FC1), mapY(nAngles, nRadii, CV_32FC1);
+	for (int a = 0; a < nAngles; a++) {
+		double theta = a * CV_PI / nAngles;
+		for (int k = 0; k < nRadii; k++) {
+			double rho = rMin * exp(k * logStep);
+			// spectra are not shifted, negative frequencies wrap around
+			mapX.at<float>(a, k) = rho * cos(theta);
+			mapY.at<float>(a, k) = rho * sin(theta);
+		}
+	}
+
+	Mat logPolar[2];
+	Mat magn[2] = {templMagn, imageMagn};
+	for (int i = 0; i < 2; i++) {
+		Mat frame = Mat::zeros(size, size, CV_32FC1);
+		magn[i].copyTo(frame(Rect(0, 0, magn[i].cols, magn[i].rows)));
+		Mat spectrum;
+		Fft::dft(frame, spectrum, DFT_COMPLEX_OUTPUT, fftDepth);
+		split(spectrum, planes);
+		magnitude(planes[0], planes[1], planes[0]);
+		// compress dynamic range
+		log(planes[0] + 1, planes[0]);
+		remap(planes[0], logPolar[i], mapX, mapY, INTER_LINEAR, BORDER_WRAP);
+	}
+
+	// phase correlation: peak at the shift of the test image relative to the template
+	Mat templSpec, imageSpec, cross;
+	Fft::dft(logPolar[0], templSpec, DFT_COMPLEX_OUTPUT, fftDepth);
+	Fft::dft(logPolar[1], imageSpec, DFT_COMPLEX_OUTPUT, fftDepth);
+	mulSpectrums(imageSpec, templSpec, cross, 0, true);
+	split(cross, planes);
+	Mat crossMagn;
+	magnitude(planes[0], planes[1], crossMagn);
+	crossMagn += 1e-10;
+	divide(planes[0], crossMagn, planes[0]);
+	divide(planes[1], crossMagn, planes[1]);
+	merge(planes, 2, cross);
+	Mat corr;
+	Fft::dft(cross, corr, DFT_INVERSE | DFT_SCALE | DFT_REAL_OUTPUT, fftDepth);
+
+	// strongest peaks
+	candidates.clear();
+	for (int p = 0; p < numPeaks; p++) {
+		double minVal, maxVal;
+		Point peak;
+		minMaxLoc(corr, &minVal, &maxVal, 0, &peak);
+
+		// signed shifts: along angles (periodic with pi) and along log-radii
+		int da = (peak.y > nAngles / 2) ? peak.y - nAngles : peak.y;
+		int dk = (peak.x > nRadii / 2) ? peak.x - nRadii : peak.x;
+
+		// a scaled object has a spectrum scaled by the inverse factor
+		double scale = exp(-dk * logStep);
+		double angle = da * CV_PI / nAngles;
+		if (angle < 0) angle += CV_PI;
+		candidates.push_back(Vec2d(scale, angle));
+		candidates.push_back(Vec2d(scale, angle + CV_PI));
+
+		// suppress neighborhood of this peak
+		for (int y = -2; y <= 2; y++) {
+			for (int x = -2; x <= 2; x++) {
+				corr.at<float>((peak.y + y + nAngles) % nAngles, (peak.x + x + nRadii) % nRadii) = minVal;
+			}
+		}
+	}
+}
+
+// selects the poses of the scale/angle-grid close to estimated scales and angles
+/*
+candidates:	estimated (scale, angle) pairs, e.g. from fourierMellin(..)
+band:		number of neighboring grid steps kept on each side of a candidate
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+poses:		the selected jobs with their grid indices, each pose at most once, in grid order; the whole grid if nothing
+			is selected
+*/
+void Aia3::bandHoughPoses(const vector<Vec2d>& candidates, int band, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, vector<HoughPose>& poses) {
+
+	vector<HoughPose> grid;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, grid);
+
+	double scaleStep = (scaleRange[1] - scaleRange[0]) / scaleSteps;
+	double angleStep = (angleRange[1] - angleRange[0]) / angleSteps;
+	bool periodic = fabs(angleRange[1] - angleRange[0] - 2 * CV_PI) < 1e-6;
+
+	// mark selected grid cells
+	vector<bool> selected(grid.size(), false);
+	for (size_t c = 0; c < candidates.size(); c++) {
+		// estimates outside of the grid select the nearest border cells
+		int si = std::min(std::max(cvRound((candidates[c][0] - scaleRange[0]) / scaleStep), 0), (int)scaleSteps - 1);
+		double angle = candidates[c][1] - angleRange[0];
+		if (periodic) {
+			angle = fmod(fmod(angle, 2 * CV_PI) + 2 * CV_PI, 2 * CV_PI);
+		}
+		int ai = cvRound(angle / angleStep);
+		if (!periodic) {
+			ai = std::min(std::max(ai, 0), (int)angleSteps - 1);
+		}
+		for (int i = si - band; i <= si + band; i++) {
+			if ((i < 0) || (i >= scaleSteps)) {
+				continue;
+			}
+			for (int j = ai - band; j <= ai + band; j++) {
+				int jj = periodic ? ((j % (int)angleSteps) + (int)angleSteps) % (int)angleSteps : j;
+				if ((jj < 0) || (jj >= angleSteps)) {
+					continue;
+				}
+				selected[i * (int)angleSteps + jj] = true;
+			}
+		}
+	}
+
+	poses.clear();
+	for (size_t k = 0; k < grid.size(); k++) {
+		if (selected[k]) {
+			poses.push_back(grid[k]);
+		}
+	}
+
+	// no estimate at all: search the whole grid
+	if (poses.empty()) {
+		poses = grid;
+	}
+}
+
+// number of gradient orientation bins of the r-tables
+static const int rTableBins = 16;
+
+// sorts all pixels with significant gradient magnitude into an r-table
+/*
+complexGrad:	complex gradient image (CV_32FC2), e.g. gradient image of the test image or masked object template
+edgeThresh:	relative threshold on the gradient magnitude; 0 keeps all pixels with non-zero gradient
+centered:	if true, positions are stored as offsets to the image center (used for templates)
+table:		the resulting r-table
+*/
+void Aia3::makeRTable(const Mat& complexGrad, double edgeThresh, bool centered, RTable& table) {
+
+	// threshold relative to the strongest gradient
+	double maxMagn = 0;
+	for (int y = 0; y < complexGrad.rows; y++) {
+		const Vec2f* g = complexGrad.ptr<Vec2f>(y);
+		for (int x = 0; x < complexGrad.cols; x++) {
+			maxMagn = std::max(maxMagn, (double)(g[x][0] * g[x][0] + g[x][1] * g[x][1]));
+		}
+	}
+	double thresh = edgeThresh * edgeThresh * maxMagn;
+
+	// collect edge pixels per orientation bin
+	vector< vector<Vec4f> > bins(rTableBins);
+	int cx = centered ? complexGrad.cols / 2 : 0;
+	int cy = centered ? complexGrad.rows / 2 : 0;
+	for (int y = 0; y < complexGrad.rows; y++) {
+		const Vec2f* g = complexGrad.ptr<Vec2f>(y);
+		for (int x = 0; x < complexGrad.cols; x++) {
+			double magn = g[x][0] * g[x][0] + g[x][1] * g[x][1];
+			if ((magn == 0) || (magn <= thresh)) {
+				continue;
+			}
+			int b = (int)floor((atan2(g[x][1], g[x][0]) + CV_PI) / (2 * CV_PI) * rTableBins);
+			bins[b % rTableBins].push_back(Vec4f(x - cx, y - cy, g[x][0], g[x][1]));
+		}
+	}
+
+	// concatenate bins
+	table.entries.clear();
+	table.binStart.assign(1, 0);
+	for (int b = 0; b < rTableBins; b++) {
+		table.entries.insert(table.entries.end(), bins[b].begin(), bins[b].end());
+		table.binStart.push_back(table.entries.size());
+	}
+}
+
+// accumulates the votes of all image edges for one scaled and rotated template
+/*
+each image edge votes for all positions of the object center that are consistent with a template edge of similar
+(or opposite) orientation; the weight is the real part of the product of image gradient and conjugated template gradient.
+this only approximates the (circular) correlation computed by correlate(..): just 6 of the rTableBins orientation bins
+are paired with each image bin, and image edges below the threshold of makeRTable(..) do not vote at all
+edges:		r-table of the test image edges (absolute positions)
+rTable:		r-table of the template (offsets to the template center)
+result:		absolute value of the accumulated votes (CV_32FC1, initialized outside of this function)
+*/
+void Aia3::vote(const RTable& edges, const RTable& rTable, Mat& result) {
+
+	result.setTo(0);
+
+	// neighboring bins of same and of opposite orientation
+	int offsets[6] = {-1, 0, 1, rTableBins / 2 - 1, rTableBins / 2, rTableBins / 2 + 1};
+
+	for (int bi = 0; bi < rTableBins; bi++) {
+		for (int o = 0; o < 6; o++) {
+			int bt = (bi + offsets[o] + rTableBins) % rTableBins;
+			for (int e = edges.binStart[bi]; e < edges.binStart[bi + 1]; e++) {
+				const Vec4f& edge = edges.entries[e];
+				for (int t = rTable.binStart[bt]; t < rTable.binStart[bt + 1]; t++) {
+					const Vec4f& entry = rTable.entries[t];
+					// object center, wrapped around as for the circular correlation; offsets of templates larger than
+					// the image may exceed the image size several times
+					int x = ((int)(edge[0] - entry[0]) % result.cols + result.cols) % result.cols;
+					int y = ((int)(edge[1] - entry[1]) % result.rows + result.rows) % result.rows;
+					result.at<float>(y, x) += edge[2] * entry[2] + edge[3] * entry[3];
+				}
+			}
+		}
+	}
+
+	// absolute value as for the correlation
+	result = abs(result);
+}
+
+// computes the reduced hough space by sparse voting of the image edges
+/*
+an approximation of generalHough(..), see vote(..); it is never chosen automatically
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles to be investigated
+edgeThresh:	relative threshold on the gradient magnitude of the test image
+houghSpace:	the reduced hough space
+*/
+void Aia3::houghVote(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double edgeThresh, ReducedHough& houghSpace) {
+
+	// reset reduced hough space
+	houghSpace = ReducedHough();
+
+	// edges of the test image are shared by all jobs
+	RTable edges;
+	makeRTable(gradImage, edgeThresh, false, edges);
+
+	// same batch processing as for the correlation
+	int batchSize = std::max(getNumThreads(), 1);
+	if (maxJobs > 0) {
+		batchSize = std::min(batchSize, maxJobs);
+	}
+	vector<HoughWorkspace> workspaces(batchSize);
+
+	for (int first = 0; first < (int)poses.size(); first += batchSize) {
+
+		int n = std::min(batchSize, (int)poses.size() - first);
+
+		parallel_for_(Range(0, n), HoughVoteBody(this, gradImage.size(), edges, templ, poses, first, workspaces), n);
+
+		for (int k = 0; k < n; k++) {
+			accumulateHough(workspaces[k].result, poses[first + k].scaleIdx, poses[first + k].angleIdx, houghSpace);
+		}
+	}
+}
+
+// decides whether sparse voting is cheaper than correlation in the frequency domain
+/*
+the costs are estimated from the measured number of image edges and template edges
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+poses:		the scales and angles to be investigated
+edgeThresh:	relative threshold on the gradient magnitude of the test image
+bank:		whether the template spectra are precomputed (see TemplateBank)
+return:		true if houghVote(..) should be used instead of generalHough(..)
+*/
+bool Aia3::preferHoughVote(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double edgeThresh, bool bank) {
+
+	// measured edge densities
+	RTable edges;
+	makeRTable(gradImage, edgeThresh, false, edges);
+	double imageEdges = edges.entries.size();
+	double templEdges = countNonZero(templ[0]);
+
+	// cost per job of the correlation: inverse fft, plus forward fft of the template unless it is taken from the bank
+	double n = gradImage.total();
+	double fftCost = (bank ? 1 : 2) * 5 * n * log(n) / log(2.);
+
+	// cost per job of the voting: 6 of all orientation bins are paired, a vote is a scattered memory access
+	double voteCost = 0;
+	for (size_t k = 0; k < poses.size(); k++) {
+		voteCost += 4 * imageEdges * templEdges * poses[k].scale * poses[k].scale * 6 / rTableBins;
+	}
+
+	return voteCost < fftCost * poses.size();
+}
+
+// fourier-spectrum of the gradient image of the test image
+/*
+the image is not padded: the correlation is circular over the image itself, exactly as the periodic continuation used
+by tiledHough(..), localHough(..), pyramidHough(..) and houghResponse(..); sizes with large prime factors are handled by
+the fourier transformation itself (see Fft)
+gradImage:	the gradient image of the test image
+spectrum:	fourier-spectrum of the gradient image (CV_32FC2)
+*/
+void Aia3::imageSpectrum(const Mat& gradImage, Mat& spectrum) {
+
+	Fft::dft(gradImage, spectrum, DFT_COMPLEX_OUTPUT, fftDepth);
+}
+
+// correlates the test image with a template in the frequency domain
+/*
+imageSpectrum:	fourier-spectrum of the gradient image of the test image
+fftMask:		fourier-spectrum of the scaled and rotated template
+size:			size of the test image; the correlation is cropped to it (tiles of tiledHough(..) are larger)
+Correlation_DFT:	scratch memory for the correlation spectrum; reused if already allocated
+result:			absolute real part of the correlation (CV_32FC1)
+*/
+void Aia3::correlate(const Mat& imageSpectrum, const Mat& fftMask, Size size, Mat& Correlation_DFT, Mat& result) {
+
+	result.create(size.height, size.width, CV_32FC1);
+
+	//...correlation in the frequency domain and back to the spatial domain, absolute value stored row by row
+	Fft::correlate(imageSpectrum, fftMask, Correlation_DFT, size, [&result](int y, const float* corr) {
+		memcpy(result.ptr<float>(y), corr, result.cols * sizeof(float));
+	}, fftDepth);
+}
+
+// correlates the test image with a template and folds the response directly into the reduced hough space
+/*
+same as correlate(..) followed by accumulateHough(..), but the response is combined row by row while it is extracted
+from the inverse transformation, hence no response image is written and read again
+imageSpectrum:	fourier-spectrum of the gradient image of the test image
+fftMask:		fourier-spectrum of the scaled and rotated template
+size:			size of the test image; the correlation is cropped to it (tiles of tiledHough(..) are larger)
+Correlation_DFT:	scratch memory for the correlation spectrum; reused if already allocated
+scale:			index of the scale
+angle:			index of the angle
+houghSpace:		the reduced hough space; initialized on first call
+*/
+void Aia3::correlateHough(const Mat& imageSpectrum, const Mat& fftMask, Size size, Mat& Correlation_DFT, int scale, int angle, ReducedHough& houghSpace) {
+
+	if (houghSpace.maxImage.empty()) {
+		initHough(size, houghSpace);
+	}
+
+	Fft::correlate(imageSpectrum, fftMask, Correlation_DFT, size, [&](int y, const float* corr) {
+		float* maxRow = houghSpace.maxImage.ptr<float>(y);
+		float* sumRow = houghSpace.sumImage.ptr<float>(y);
+		float* scaleRow = houghSpace.scaleIdx.ptr<float>(y);
+		float* angleRow = houghSpace.angleIdx.ptr<float>(y);
+		for (int x = 0; x < size.width; x++) {
+			// argmax: only strictly larger responses replace the current pose
+			if (corr[x] > maxRow[x]) {
+				maxRow[x] = corr[x];
+				scaleRow[x] = (float)scale;
+				angleRow[x] = (float)angle;
+			}
+			sumRow[x] += corr[x];
+		}
+	}, fftDepth);
+}
+
+// correlates the test image with a template and stores the response as 16 bit integers normalized per plane
+/*
+the correlation is fused as in correlateHough(..): the maximum is taken while the absolute real part is extracted, and
+each row is kept in a float buffer reused by the calling thread, from which it is quantized once the maximum is known;
+the response is result * scale, with an absolute error of at most scale / 2 plus the rounding of scale, i.e. at most
+7.7e-6 times the maximal response of the plane
+imageSpectrum:	fourier-spectrum of the gradient image of the test image, as computed by imageSpectrum(..)
+fftMask:	fourier-spectrum of the scaled and rotated template
+size:		size of the gradient image of the test image
+Correlation_DFT:	working copy of Fft::correlate(..); reused if already allocated
+result:		the quantized hough response (CV_16UC1, size of the gradient image)
+scale:		the scale of the plane, i.e. the maximal response divided by 65535 (one for a zero response)
+*/
+void Aia3::correlate(const Mat& imageSpectrum, const Mat& fftMask, Size size, Mat& Correlation_DFT, Mat& result, float& scale) {
+
+	//...correlation, the maximal absolute value within the image is found while the rows are extracted
+	static thread_local Mat response;
+	response.create(size.height, size.width, CV_32FC1);
+	float maxResponse = 0;
+	Fft::correlate(imageSpectrum, fftMask, Correlation_DFT, size, [&maxResponse, &size](int y, const float* corr) {
+		float* res = response.ptr<float>(y);
+		for (int x = 0; x < size.width; x++) {
+			res[x] = corr[x];
+			maxResponse = std::max(maxResponse, corr[x]);
+		}
+	}, fftDepth);
+	scale = (maxResponse > 0) ? maxResponse / 65535 : 1;
+	float gain = 1 / scale;
+
+	// quantization of the extracted rows
+	result.create(size.height, size.width, CV_16UC1);
+	for (int y = 0; y < result.rows; y++) {
+
+		const float* corr = response.ptr<float>(y);
+		ushort* res = result.ptr<ushort>(y);
+
+		for (int x = 0; x < result.cols; x++) {
+			res[x] = saturate_cast<ushort>(corr[x] * gain);
+		}
+	}
+}
+
+// folds the hough response of one scale and angle into the reduced hough space
+/*
+a position keeps the first scale and angle with maximal response (same order as in the full hough space)
+result:		hough response of the given scale and angle
+scale:		index of the scale
+angle:		index of the angle
+houghSpace:	the reduced hough space; initialized on first call
+*/
+void Aia3::accumulateHough(const Mat& result, int scale, int angle, ReducedHough& houghSpace) {
+
+	if (houghSpace.maxImage.empty()) {
+		initHough(result.size(), houghSpace);
+	}
+
+	// argmax: only strictly larger responses replace the current pose
+	Mat larger = result > houghSpace.maxImage;
+	houghSpace.scaleIdx.setTo(scale, larger);
+	houghSpace.angleIdx.setTo(angle, larger);
+
+	// maximum and sum over scales and angles
+	max(result, houghSpace.maxImage, houghSpace.maxImage);
+	houghSpace.sumImage += result;
+}
+
+// initializes an empty reduced hough space
+/*
+size:		size of the test image
+houghSpace:	the reduced hough space; all responses and indices are set to zero
+*/
+void Aia3::initHough(Size size, ReducedHough& houghSpace) {
+
+	houghSpace.maxImage = Mat::zeros(size.height, size.width, CV_32FC1);
+	houghSpace.sumImage = Mat::zeros(size.height, size.width, CV_32FC1);
+	houghSpace.scaleIdx = Mat::zeros(size.height, size.width, CV_32FC1);
+	houghSpace.angleIdx = Mat::zeros(size.height, size.width, CV_32FC1);
+}
+
+// folds a part of a reduced hough space into a larger one
+/*
+part:		reduced hough space of an image window
+roi:		region of part to be merged
+offset:		position of the upper left corner of roi within houghSpace; positions outside of houghSpace are skipped
+houghSpace:	the reduced hough space; each position keeps the pose with the larger response
+*/
+void Aia3::mergeHough(const ReducedHough& part, Rect roi, Point offset, ReducedHough& houghSpace) {
+
+	for (int y = 0; y < roi.height; y++) {
+		int new_y = offset.y + y;
+		if ((new_y < 0) || (new_y >= houghSpace.maxImage.rows)) {
+			continue;
+		}
+		for (int x = 0; x < roi.width; x++) {
+			int new_x = offset.x + x;
+			if ((new_x < 0) || (new_x >= houghSpace.maxImage.cols)) {
+				continue;
+			}
+			float val = part.maxImage.at<float>(roi.y + y, roi.x + x);
+			if (val > houghSpace.maxImage.at<float>(new_y, new_x)) {
+				houghSpace.maxImage.at<float>(new_y, new_x) = val;
+				houghSpace.scaleIdx.at<float>(new_y, new_x) = part.scaleIdx.at<float>(roi.y + y, roi.x + x);
+				houghSpace.angleIdx.at<float>(new_y, new_x) = part.angleIdx.at<float>(roi.y + y, roi.x + x);
+			}
+			// windows may overlap: keep the larger projection instead of counting twice
+			houghSpace.sumImage.at<float>(new_y, new_x) = std::max(houghSpace.sumImage.at<float>(new_y, new_x), part.sumImage.at<float>(roi.y + y, roi.x + x));
+		}
+	}
+}
+
+// shows hough space, eg. as a projection of angle- and scale-dimensions down to a single image
+/*
+houghSpace:	the hough space as generated by generalHough(..)
+*/
+void Aia3::plotHough(const vector< vector<Mat> >& houghSpace) {
+
+	Mat Spacehough = Mat::zeros(houghSpace.at(0).at(0).rows, houghSpace.at(0).at(0).cols, CV_32FC1);
+
+	// loop over all dimensions
+	for (int scale = 0; scale < houghSpace.size(); ++scale) {
+		for (int orientation = 0; orientation < houghSpace.at(scale).size(); ++orientation) {
+			Mat fixed = houghSpace.at(scale).at(orientation);
+			for (int i = 0; i < fixed.rows; ++i) {
+				for (int j = 0; j < fixed.cols; ++j) {
+
+					Spacehough.at<float>(i, j) += fixed.at<float>(i, j);
+				}
+			}
+		}
+	}
+
+
+	showImage(Spacehough, "Hough Space", 0);
+	Mat tempImage;
+	normalize(Spacehough, tempImage, 0, 255, CV_MINMAX);
+	tempImage.convertTo(tempImage, CV_8UC1);
+	imwrite("hough_space.png", tempImage);
+}
+
+// shows the reduced hough space as a projection of angle- and scale-dimensions down to a single image
+/*
+houghSpace:	the reduced hough space as generated by generalHough(..)
+*/
+void Aia3::plotHough(const ReducedHough& houghSpace) {
+
+	// the projection has already been accumulated during the hough transform
+	showImage(houghSpace.sumImage, "Hough Space", 0);
+	Mat tempImage;
+	normalize(houghSpace.sumImage, tempImage, 0, 255, CV_MINMAX);
+	tempImage.convertTo(tempImage, CV_8UC1);
+	imwrite("hough_space.png", tempImage);
+}
+
+
+
+// offset of the plane scales in a hough volume file, a multiple of the page size
+static const size_t volumeOffset = 4096;
+
+// offset of the first plane in a hough volume file: the plane scales are followed by the planes, both page aligned
+/*
+header:	description of the grid
+return:	the offset in bytes
+*/
+static size_t planesOffset(const HoughVolumeHeader& header) {
+
+	size_t scaleBytes = (size_t)header.scaleSteps * header.angleSteps * sizeof(float);
+	return volumeOffset + (scaleBytes + volumeOffset - 1) / volumeOffset * volumeOffset;
+}
+
+// size of a hough volume file
+/*
+header:	description of the grid
+return:	the size in bytes
+*/
+static size_t volumeBytes(const HoughVolumeHeader& header) {
+
+	return planesOffset(header) + (size_t)header.scaleSteps * header.angleSteps * header.rows * header.cols * CV_ELEM_SIZE(header.depth);
+}
+
+// computes the planes of one batch of jobs of a hough volume, each job in its own workspace
+class HoughVolumeBody : public ParallelLoopBody {
+
+	public:
+		HoughVolumeBody(Aia3* aia3, const Mat& imageSpectrum, Size imageSize, const vector<Mat>& templ, const vector<HoughPose>& poses, int first, vector<HoughWorkspace>& workspaces, HoughVolume& volume)
+			: aia3(aia3), imageSpectrum(imageSpectrum), imageSize(imageSize), templ(templ), poses(poses), first(first), workspaces(workspaces), volume(volume) {};
+
+		void operator()(const Range& range) const {
+			for (int k = range.start; k < range.end; k++) {
+				const HoughPose& pose = poses[first + k];
+				HoughWorkspace& ws = workspaces[k];
+				// the plane already has the size of the response, hence the response is written into the mapping
+				Mat plane = volume.planes[pose.scaleIdx][pose.angleIdx];
+				aia3->makeFFTObjectMask(templ, pose.scale, pose.angle, ws.fftMask, ws);
+				if (volume.header.depth == CV_16U) {
+					aia3->correlate(imageSpectrum, ws.fftMask, imageSize, ws.spectrum, plane, volume.scales[pose.scaleIdx * volume.header.angleSteps + pose.angleIdx]);
+				}
+				else {
+					aia3->correlate(imageSpectrum, ws.fftMask, imageSize, ws.spectrum, plane);
+				}
+			}
+		}
+
+	private:
+		Aia3* aia3;
+		const Mat& imageSpectrum;
+		Size imageSize;
+		const vector<Mat>& templ;
+		const vector<HoughPose>& poses;
+		int first;
+		vector<HoughWorkspace>& workspaces;
+		HoughVolume& volume;
+};
+
+// computes the full hough space of the general hough transform into a memory-mapped file
+/*
+same planes as generalHough(..) returning the hough space in memory, but each plane is written directly into the
+mapping; residency is left to the page cache, hence the volume may be larger than the main memory.
+with depth CV_16U each plane is stored as 16 bit integers normalized to the maximum of the plane (see correlate(..)),
+which halves file size and memory traffic; the absolute error of a response is at most 7.7e-6 times the maximum of
+its plane, hence of the whole hough space
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+volumeFile:	path of the file, created or overwritten
+depth:		depth of the stored planes, CV_32F or CV_16U
+volume:		the mapped hough volume, to be closed by closeHoughVolume(..)
+*/
+void Aia3::generalHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, string volumeFile, int depth, HoughVolume& volume) {
+
+	HoughVolumeHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "AIAHOUGH", sizeof(header.magic));
+	header.depth = depth;
+	header.rows = gradImage.rows;
+	header.cols = gradImage.cols;
+	header.scaleSteps = (int)scaleSteps;
+	header.angleSteps = (int)angleSteps;
+	header.scaleRange[0] = scaleRange[0];
+	header.scaleRange[1] = scaleRange[1];
+	header.angleRange[0] = angleRange[0];
+	header.angleRange[1] = angleRange[1];
+	createHoughVolume(volumeFile, header, volume);
+
+	//...convert gradImage to the frequency domain: ImageMask
+	Mat ImageMask_DFT;
+	imageSpectrum(gradImage, ImageMask_DFT);
+
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+
+	// same batches as houghSweep(..), but the responses are the planes of the volume
+	int batchSize = std::max(getNumThreads(), 1);
+	if (maxJobs > 0) {
+		batchSize = std::min(batchSize, maxJobs);
+	}
+	vector<HoughWorkspace> workspaces(batchSize);
+	for (int k = 0; k < batchSize; k++) {
+		reserveObjectMask(templ, poses, ImageMask_DFT.size(), workspaces[k]);
+	}
+
+	for (int first = 0; first < (int)poses.size(); first += batchSize) {
+
+		int n = std::min(batchSize, (int)poses.size() - first);
+
+		parallel_for_(Range(0, n), HoughVolumeBody(this, ImageMask_DFT, gradImage.size(), templ, poses, first, workspaces, volume), n);
+	}
+}
+
+// sets plane scales and planes of a hough volume to the mapped memory
+/*
+volume:	the hough volume with header, data and bytes set
+*/
+static void mapHoughPlanes(HoughVolume& volume) {
+
+	const HoughVolumeHeader& header = volume.header;
+	size_t planeBytes = (size_t)header.rows * header.cols * CV_ELEM_SIZE(header.depth);
+	volume.scales = (float*)(volume.data + volumeOffset);
+	uchar* plane = volume.data + planesOffset(header);
+	volume.planes.assign(header.scaleSteps, vector<Mat>(header.angleSteps));
+	for (int s = 0; s < header.scaleSteps; s++) {
+		for (int a = 0; a < header.angleSteps; a++) {
+			volume.planes[s][a] = Mat(header.rows, header.cols, CV_MAKETYPE(header.depth, 1), plane);
+			plane += planeBytes;
+		}
+	}
+}
+
+// creates a hough volume file of the given grid and maps it for writing
+/*
+volumeFile:	path of the file, created or overwritten
+header:		description of the grid, depth CV_32F or CV_16U
+volume:		the mapped hough volume; its planes are uninitialized (zero), the plane scales are one
+*/
+void Aia3::createHoughVolume(string volumeFile, const HoughVolumeHeader& header, HoughVolume& volume) {
+
+#ifdef _WIN32
+	cerr << "ERROR: Memory-mapped hough volumes are not supported on this platform" << endl;
+	exit(-1);
+#else
+	CV_Assert((header.depth == CV_32F) || (header.depth == CV_16U));
+	size_t bytes = volumeBytes(header);
+	int fd = open(volumeFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if ((fd < 0) || (ftruncate(fd, (off_t)bytes) != 0)) {
+		cerr << "ERROR: Cannot create hough volume\n" << volumeFile << endl;
+		exit(-1);
+	}
+	void* data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		cerr << "ERROR: Cannot map hough volume\n" << volumeFile << endl;
+		exit(-1);
+	}
+	memcpy(data, &header, sizeof(header));
+
+	volume.header = header;
+	volume.data = (uchar*)data;
+	volume.bytes = bytes;
+	mapHoughPlanes(volume);
+	std::fill(volume.scales, volume.scales + header.scaleSteps * header.angleSteps, 1.f);
+#endif
+}
+
+// maps an existing hough volume file for reading
+/*
+the planes are read-only and are paged in on access, e.g. by findHoughMaxima(..) or plotHough(..); 16 bit planes have to
+be read by volumePlane(..)
+volumeFile:	path of the file as written by generalHough(..)
+volume:		the mapped hough volume, to be closed by closeHoughVolume(..)
+*/
+void Aia3::openHoughVolume(string volumeFile, HoughVolume& volume) {
+
+#ifdef _WIN32
+	cerr << "ERROR: Memory-mapped hough volumes are not supported on this platform" << endl;
+	exit(-1);
+#else
+	int fd = open(volumeFile.c_str(), O_RDONLY);
+	struct stat info;
+	if ((fd < 0) || (fstat(fd, &info) != 0) || ((size_t)info.st_size < volumeOffset)) {
+		cerr << "ERROR: Cannot open hough volume\n" << volumeFile << endl;
+		exit(-1);
+	}
+	size_t bytes = (size_t)info.st_size;
+	void* data = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		cerr << "ERROR: Cannot map hough volume\n" << volumeFile << endl;
+		exit(-1);
+	}
+
+	// the grid has to match the file
+	HoughVolumeHeader header;
+	memcpy(&header, data, sizeof(header));
+	bool valid = (memcmp(header.magic, "AIAHOUGH", sizeof(header.magic)) == 0) && ((header.depth == CV_32F) || (header.depth == CV_16U))
+		&& (header.rows > 0) && (header.cols > 0) && (header.scaleSteps > 0) && (header.angleSteps > 0)
+		&& (bytes == volumeBytes(header));
+	if (!valid) {
+		munmap(data, bytes);
+		cerr << "ERROR: Invalid hough volume\n" << volumeFile << endl;
+		exit(-1);
+	}
+	// planes are usually read one after another
+	madvise(data, bytes, MADV_SEQUENTIAL);
+
+	volume.header = header;
+	volume.data = (uchar*)data;
+	volume.bytes = bytes;
+	mapHoughPlanes(volume);
+#endif
+}
+
+// unmaps a hough volume; written planes are kept in the file
+/*
+volume:	the hough volume, its planes must not be used afterwards
+*/
+void Aia3::closeHoughVolume(HoughVolume& volume) {
+
+	volume.planes.clear();
+	volume.scales = NULL;
+#ifndef _WIN32
+	if (volume.data) {
+		munmap(volume.data, volume.bytes);
+	}
+#endif
+	volume.data = NULL;
+	volume.bytes = 0;
+}
+
+// hough responses of one plane of a hough volume
+/*
+volume:	the hough volume
+s:		index of the scale
+a:		index of the angle
+plane:	the responses (CV_32FC1); the mapped plane itself for CV_32F, otherwise converted with the scale of the plane
+*/
+void Aia3::volumePlane(const HoughVolume& volume, int s, int a, Mat& plane) {
+
+	const Mat& stored = volume.planes[s][a];
+	if (stored.depth() == CV_32F) {
+		plane = stored;
+	}
+	else {
+		stored.convertTo(plane, CV_32F, volume.scales[s * volume.header.angleSteps + a]);
+	}
+}
+
+// seeks for local maxima within a hough volume
+/*
+same as for the hough space in memory, the planes are streamed from the mapping one after another
+volume:		the hough volume
+objThresh:	relative threshold for maxima in hough space
+objList:	list of detected objects
+*/
+void Aia3::findHoughMaxima(const HoughVolume& volume, double objThresh, vector<Scalar>& objList) {
+
+	// get maxima and best pose over scales and angles
+	ReducedHough reduced;
+	Mat plane;
+	for (int s = 0; s < volume.header.scaleSteps; s++) {
+		for (int a = 0; a < volume.header.angleSteps; a++) {
+			volumePlane(volume, s, a, plane);
+			accumulateHough(plane, s, a, reduced);
+		}
+	}
+
+	findHoughMaxima(reduced, objThresh, objList);
+}
+
+// shows a hough volume as a projection of angle- and scale-dimensions down to a single image
+/*
+volume:	the hough volume
+*/
+void Aia3::plotHough(const HoughVolume& volume) {
+
+	Mat Spacehough = Mat::zeros(volume.header.rows, volume.header.cols, CV_32FC1);
+	Mat plane;
+	for (int s = 0; s < volume.header.scaleSteps; s++) {
+		for (int a = 0; a < volume.header.angleSteps; a++) {
+			volumePlane(volume, s, a, plane);
+			Spacehough += plane;
+		}
+	}
+
+	showImage(Spacehough, "Hough Space", 0);
+	Mat tempImage;
+	normalize(Spacehough, tempImage, 0, 255, CV_MINMAX);
+	tempImage.convertTo(tempImage, CV_8UC1);
+	imwrite("hough_space.png", tempImage);
+}
+
+/* *****************************
+GIVEN FUNCTIONS
+***************************** */
+
+// processing parameters of run(..), for one or several templates
+/*
+return:	sigma, templateThresh, objThresh, scaleSteps, scaleRange, angleSteps, angleRange as expected by process(..)
+*/
+Mat Aia3::runParams(void) {
 
 	// processing parameter
 	double sigma = 1;		// standard deviation of directional gradient kernel
 	double templateThresh = 0.3;		// relative threshold for binarization of the template image
-										// TO DO !!!
-										// ****
-										// Set parameters to reasonable values
+										// TO DO !!!
+										// ****
+										// Set parameters to reasonable values
+	double objThresh = 0.53;		// relative threshold for maxima in hough space
+	double scaleSteps = 33;		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];				// scale of angles [min, max]
+	scaleRange[0] = 0.5;
+	scaleRange[1] = 2;
+	double angleSteps = 4;		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];				// range of angles [min, max)
+	angleRange[0] = 0;
+	angleRange[1] = 2 * CV_PI;
+	// ****
+
+	return (Mat_<float>(1, 9) << sigma, templateThresh, objThresh, scaleSteps, scaleRange[0], scaleRange[1], angleSteps, angleRange[0], angleRange[1]);
+}
+
+// loads template and test images, sets parameters and calls processing routine
+/*
+tmplImg:	path to template image
+testImg:	path to test image
+*/
+void Aia3::run(string tmplImg, string testImg) {
+
+	// processing parameter, see runParams(..)
+	Mat params = runParams();
+
+	// load template image as gray-scale, paths in argv[1]
+	Mat templateImage = imread(tmplImg, 0);
+	if (!templateImage.data) {
+		cerr << "ERROR: Cannot load template image from\n" << tmplImg << endl;
+		cerr << "Press enter..." << endl;
+		cin.get();
+		exit(-1);
+	}
+	// convert 8U to 32F
+	templateImage.convertTo(templateImage, CV_32FC1);
+	// show template image
+	showImage(templateImage, "Template image", 0);
+
+	// load test image
+	Mat testImage = imread(testImg, 0);
+	if (!testImage.data) {
+		cerr << "ERROR: Cannot load test image from\n" << testImg << endl;
+		cerr << "Press enter..." << endl;
+		cin.get();
+		exit(-1);
+	}
+	// and convert it from 8U to 32F
+	testImage.convertTo(testImage, CV_32FC1);
+	// show test image
+	showImage(testImage, "testImage", 0);
+
+	// start processing
+	process(templateImage, testImage, params);
+
+}
+
+// loads several template images and one test image, sets parameters and calls processing routine for all templates
+/*
+tmplImgs:	paths to template images
+testImg:	path to test image
+*/
+void Aia3::run(const vector<string>& tmplImgs, string testImg) {
+
+	// processing parameter, same as for a single template (see runParams(..))
+	Mat params = runParams();
+	double scaleSteps = params.at<float>(3);		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];				// scale of angles [min, max]
+	scaleRange[0] = params.at<float>(4);
+	scaleRange[1] = params.at<float>(5);
+	double angleSteps = params.at<float>(6);		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];				// range of angles [min, max)
+	angleRange[0] = params.at<float>(7);
+	angleRange[1] = params.at<float>(8);
+
+	// load template images as gray-scale
+	vector<Mat> templateImages;
+	for (size_t t = 0; t < tmplImgs.size(); t++) {
+		Mat templateImage = imread(tmplImgs[t], 0);
+		if (!templateImage.data) {
+			cerr << "ERROR: Cannot load template image from\n" << tmplImgs[t] << endl;
+			cerr << "Press enter..." << endl;
+			cin.get();
+			exit(-1);
+		}
+		// convert 8U to 32F
+		templateImage.convertTo(templateImage, CV_32FC1);
+		templateImages.push_back(templateImage);
+	}
+
+	// load test image
+	Mat testImage = imread(testImg, 0);
+	if (!testImage.data) {
+		cerr << "ERROR: Cannot load test image from\n" << testImg << endl;
+		cerr << "Press enter..." << endl;
+		cin.get();
+		exit(-1);
+	}
+	// and convert it from 8U to 32F
+	testImage.convertTo(testImage, CV_32FC1);
+	// show test image
+	showImage(testImage, "testImage", 0);
+
+	// start processing
+	vector< vector<Scalar> > objLists;
+	process(templateImages, testImage, params, objLists);
+
+	// print found objects on screen
+	for (size_t t = 0; t < objLists.size(); t++) {
+		cout << "Template " << tmplImgs[t] << endl;
+		cout << "Number of objects: " << objLists[t].size() << endl;
+		int i = 0;
+		for (vector<Scalar>::const_iterator it = objLists[t].begin(); it != objLists[t].end(); it++, i++) {
+			cout << i << "\tScale:\t" << (scaleRange[1] - scaleRange[0]) / scaleSteps * (*it).val[0] + scaleRange[0];
+			cout << "\tAngle:\t" << ((angleRange[1] - angleRange[0]) / (angleSteps)*(*it).val[1] + angleRange[0]) / CV_PI * 180;
+			cout << "\tPosition:\t(" << (*it).val[2] << ", " << (*it).val[3] << " )" << endl;
+		}
+	}
+}
+
+// tracks objects over the frames of a video or camera stream
+/*
+objects of the last frame are only searched in a small window of position, scale and angle; the whole hough space is
+computed for the first frame, periodically and whenever an object was lost
+tmplImg:	path to template image
+video:		path to video file, or index of a camera
+*/
+void Aia3::track(string tmplImg, string video) {
+
+	// processing parameter, same as for a single test image
+	double sigma = 1;		// standard deviation of directional gradient kernel
+	double templateThresh = 0.3;		// relative threshold for binarization of the template image
 	double objThresh = 0.53;		// relative threshold for maxima in hough space
 	double scaleSteps = 33;		// scale resolution in terms of number of scales to be investigated
 	double scaleRange[2];				// scale of angles [min, max]
@@ -288,39 +2578,753 @@ void Aia3::run(string tmplImg, string testImg) {
 	double angleRange[2];				// range of angles [min, max)
 	angleRange[0] = 0;
 	angleRange[1] = 2 * CV_PI;
-	// ****
+	// tracking parameter
+	int redetectInterval = 30;		// frames between two searches of the whole hough space
+	int searchRadius = 8;		// maximal movement of an object between two frames in pixels
+	int poseBand = 1;		// maximal change of scale and angle between two frames in steps
+	double trackThresh = 0.5;		// a tracked object is lost if its response drops below this fraction of its last response
+	double bankLimit = 1024;		// maximal memory in MB for keeping all template spectra (template bank)
+
+	// load template image as gray-scale
+	Mat templateImage = imread(tmplImg, 0);
+	if (!templateImage.data) {
+		cerr << "ERROR: Cannot load template image from\n" << tmplImg << endl;
+		cerr << "Press enter..." << endl;
+		cin.get();
+		exit(-1);
+	}
+	// convert 8U to 32F
+	templateImage.convertTo(templateImage, CV_32FC1);
+
+	// open video file or camera
+	VideoCapture capture;
+	if (!video.empty() && (video.find_first_not_of("0123456789") == string::npos)) {
+		capture.open(atoi(video.c_str()));
+	}
+	else {
+		capture.open(video);
+	}
+	if (!capture.isOpened()) {
+		cerr << "ERROR: Cannot open video\n" << video << endl;
+		cerr << "Press enter..." << endl;
+		cin.get();
+		exit(-1);
+	}
+
+	vector<Mat> templ = makeObjectTemplate(templateImage, sigma, templateThresh);
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+	bool periodic = fabs(angleRange[1] - angleRange[0] - 2 * CV_PI) < 1e-6;
+
+	vector<HoughTrack> tracks;
+	Mat frame, testImage;
+	for (int f = 0; capture.read(frame); f++) {
+
+		// gray-scale 32F frame
+		if (frame.channels() == 3) {
+			cvtColor(frame, testImage, CV_BGR2GRAY);
+		}
+		else {
+			testImage = frame;
+		}
+		testImage.convertTo(testImage, CV_32FC1);
+		Mat gradImage = calcDirectionalGrad(testImage, sigma);
+
+		// local search around the tracked objects, whole hough space if necessary
+		bool found = !tracks.empty() && (f % redetectInterval != 0);
+		if (found) {
+			found = trackHough(gradImage, templ, poses, scaleSteps, angleSteps, periodic, searchRadius, poseBand, trackThresh, tracks);
+		}
+		if (!found) {
+			ReducedHough houghSpace;
+			double bankSize = poses.size() * gradImage.total() * 2 * sizeof(float) / (1024. * 1024.);
+			if (bankSize <= bankLimit) {
+				// all frames have the same size, the template spectra are computed only once
+				updateTemplateBank(templ, gradImage.size(), poses, templateBank);
+				generalHough(gradImage, templateBank, houghSpace);
+			}
+			else {
+				generalHough(gradImage, templ, poses, houghSpace);
+			}
+			vector<Scalar> objList;
+			findHoughMaxima(houghSpace, objThresh, objList);
+
+			tracks.clear();
+			for (size_t k = 0; k < objList.size(); k++) {
+				HoughTrack track;
+				track.pose = objList[k];
+				track.score = houghSpace.maxImage.at<float>((int)objList[k].val[3], (int)objList[k].val[2]);
+				track.lost = false;
+				tracks.push_back(track);
+			}
+		}
+
+		// draw the tracked objects as rotated boxes of the template size
+		Mat display;
+		if (frame.channels() == 3) {
+			display = frame.clone();
+		}
+		else {
+			cvtColor(frame, display, CV_GRAY2BGR);
+		}
+		for (size_t t = 0; t < tracks.size(); t++) {
+			const HoughPose& pose = poses[(int)tracks[t].pose.val[0] * (int)angleSteps + (int)tracks[t].pose.val[1]];
+			RotatedRect box(Point2f(tracks[t].pose.val[2], tracks[t].pose.val[3]), Size2f(templateImage.cols * pose.scale, templateImage.rows * pose.scale), pose.angle / CV_PI * 180);
+			Point2f corners[4];
+			box.points(corners);
+			for (int c = 0; c < 4; c++) {
+				line(display, corners[c], corners[(c + 1) % 4], Scalar(0, 0, 255), 2);
+			}
+		}
+		imshow("tracking", display);
+		// stop on escape
+		if (waitKey(1) == 27) {
+			break;
+		}
+	}
+}
+
+// answers detection requests until the end of the input, without any visualization
+/*
+the template is created once; template spectra are kept per template and reused as long as image size and parameters
+do not change. requests are read from stdin, or from connections to a unix domain socket, one per line:
+	<path to test image> [key=value ...]
+	raw <rows> <cols> [key=value ...]		followed by rows*cols bytes of an 8 bit gray-scale image
+keys: template (path, created on first use), objThresh, scaleSteps, scaleMin, scaleMax, angleSteps, angleMin, angleMax
+(angles in degree). each request is answered by one line:
+	{"objects":[{"scale":..,"angle":..,"x":..,"y":..,"score":..},...],"ms":..}		or		{"error":".."}
+where ms is the time of the detection only.
+tmplImg:	path to the default template image
+socketPath:	path of the unix domain socket; empty or "-" for stdin/stdout
+*/
+void Aia3::serve(string tmplImg, string socketPath) {
+
+	// processing parameter, same as for a single test image; sigma and templateThresh are fixed for all requests
+	double sigma = 1;		// standard deviation of directional gradient kernel
+	double templateThresh = 0.3;		// relative threshold for binarization of the template image
+	double objThresh = 0.53;		// relative threshold for maxima in hough space
+	double scaleSteps = 33;		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];				// scale of angles [min, max]
+	scaleRange[0] = 0.5;
+	scaleRange[1] = 2;
+	double angleSteps = 4;		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];				// range of angles [min, max)
+	angleRange[0] = 0;
+	angleRange[1] = 2 * CV_PI;
+	double rawLimit = 64;		// maximal size of raw images in megapixels
+
+	// warm state: templates and their spectra
+	map<string, vector<Mat> > templates;
+	map<string, TemplateBank> banks;
+
+	// default template is created before the first request
+	Mat templateImage = imread(tmplImg, 0);
+	if (!templateImage.data) {
+		cerr << "ERROR: Cannot load template image from\n" << tmplImg << endl;
+		exit(-1);
+	}
+	templateImage.convertTo(templateImage, CV_32FC1);
+	templates[tmplImg] = makeObjectTemplate(templateImage, sigma, templateThresh);
+
+	// answers one request; readBytes reads the image data of raw requests
+	function<string(const string&, function<bool(char*, size_t)>)> handle = [&](const string& request, function<bool(char*, size_t)> readBytes) -> string {
+
+		istringstream in(request);
+		string source;
+		in >> source;
+		if (source.empty()) {
+			return "{\"error\":\"empty request\"}";
+		}
+
+		// image, either from file or raw bytes
+		Mat testImage;
+		if (source == "raw") {
+			int rows = 0, cols = 0;
+			in >> rows >> cols;
+			if ((rows <= 0) || (cols <= 0)) {
+				return "{\"error\":\"invalid raw image size\"}";
+			}
+			if ((double)rows * cols > rawLimit * 1024 * 1024) {
+				// skip the image data, the next request follows it
+				char skip[65536];
+				for (size_t left = (size_t)rows * cols; left > 0; ) {
+					size_t n = std::min(left, sizeof(skip));
+					if (!readBytes(skip, n)) {
+						break;
+					}
+					left -= n;
+				}
+				return "{\"error\":\"raw image too large\"}";
+			}
+			testImage.create(rows, cols, CV_8UC1);
+			if (!readBytes((char*)testImage.data, (size_t)rows * cols)) {
+				return "{\"error\":\"incomplete raw image\"}";
+			}
+		}
+		else {
+			testImage = imread(source, 0);
+			if (!testImage.data) {
+				return "{\"error\":\"cannot load test image\"}";
+			}
+		}
+		testImage.convertTo(testImage, CV_32FC1);
+
+		// parameters of this request
+		double thresh = objThresh, sSteps = scaleSteps, sRange[2] = {scaleRange[0], scaleRange[1]};
+		double aSteps = angleSteps, aRange[2] = {angleRange[0], angleRange[1]};
+		string tmplPath = tmplImg, option;
+		while (in >> option) {
+			size_t eq = option.find('=');
+			if (eq == string::npos) {
+				return "{\"error\":\"invalid option\"}";
+			}
+			string key = option.substr(0, eq), value = option.substr(eq + 1);
+			double number = atof(value.c_str());
+			if (key == "template") tmplPath = value;
+			else if (key == "objThresh") thresh = number;
+			else if (key == "scaleSteps") sSteps = number;
+			else if (key == "scaleMin") sRange[0] = number;
+			else if (key == "scaleMax") sRange[1] = number;
+			else if (key == "angleSteps") aSteps = number;
+			else if (key == "angleMin") aRange[0] = number / 180 * CV_PI;
+			else if (key == "angleMax") aRange[1] = number / 180 * CV_PI;
+			else return "{\"error\":" + jsonString("unknown option " + key) + "}";
+		}
+		string invalid = checkHoughPoses(sSteps, sRange, aSteps, aRange);
+		if (!invalid.empty()) {
+			return "{\"error\":" + jsonString(invalid) + "}";
+		}
+
+		// a failing request is answered by an error record, the service keeps running
+		vector<Scalar> objList;
+		vector<double> scores;
+		double ms = 0;
+		try {
+			// template, created on first use
+			if (!templates.count(tmplPath)) {
+				Mat templateImage = imread(tmplPath, 0);
+				if (!templateImage.data) {
+					return "{\"error\":\"cannot load template image\"}";
+				}
+				templateImage.convertTo(templateImage, CV_32FC1);
+				templates[tmplPath] = makeObjectTemplate(templateImage, sigma, templateThresh);
+			}
+
+			Mat params = (Mat_<float>(1, 9) << sigma, templateThresh, thresh, sSteps, sRange[0], sRange[1], aSteps, aRange[0], aRange[1]);
+			int64 start = getTickCount();
+			detect(testImage, templates[tmplPath], params, banks[tmplPath], objList, scores);
+			ms = (getTickCount() - start) * 1000. / getTickFrequency();
+		}
+		catch (const cv::Exception& e) {
+			banks.erase(tmplPath);
+			return "{\"error\":" + jsonString(e.err) + "}";
+		}
+		catch (const std::exception& e) {
+			banks.erase(tmplPath);
+			return "{\"error\":" + jsonString(e.what()) + "}";
+		}
+
+		ostringstream out;
+		out << "{\"objects\":" << objectRecords(objList, scores, sSteps, sRange, aSteps, aRange) << ",\"ms\":" << ms << "}";
+		return out.str();
+	};
+
+	if (socketPath.empty() || (socketPath == "-")) {
+		// requests on stdin, answers on stdout
+		string request;
+		while (getline(cin, request)) {
+			string answer = handle(request, [](char* data, size_t size) { return (bool)cin.read(data, size); });
+			cout << answer << endl;
+		}
+		return;
+	}
+
+#ifdef _WIN32
+	cerr << "ERROR: Unix domain sockets are not supported, use stdin instead" << endl;
+	exit(-1);
+#else
+	// a client closing its connection early must not terminate the service
+	signal(SIGPIPE, SIG_IGN);
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+	unlink(socketPath.c_str());
+	if ((server < 0) || (::bind(server, (sockaddr*)&address, sizeof(address)) < 0) || (listen(server, 4) < 0)) {
+		cerr << "ERROR: Cannot listen on socket\n" << socketPath << endl;
+		exit(-1);
+	}
+
+	// one connection after another, each with any number of requests
+	while (true) {
+		int connection = accept(server, NULL, NULL);
+		if (connection < 0) {
+			continue;
+		}
+		// unbuffered reading, raw image data directly follows its request line
+		function<bool(char*, size_t)> readBytes = [connection](char* data, size_t size) {
+			while (size > 0) {
+				ssize_t n = read(connection, data, size);
+				if (n <= 0) {
+					return false;
+				}
+				data += n;
+				size -= n;
+			}
+			return true;
+		};
+		string request;
+		char c;
+		while (readBytes(&c, 1)) {
+			if (c != '\n') {
+				request += c;
+				continue;
+			}
+			string answer = handle(request, readBytes) + "\n";
+			if (write(connection, answer.data(), answer.size()) < 0) {
+				break;
+			}
+			request.clear();
+		}
+		close(connection);
+	}
+#endif
+}
+
+// detects objects in many test images with a pipeline of stages running concurrently
+/*
+stages: loading (several threads), gradient and fourier transformation, hough transform (parallel over poses), maxima
+search and refinement; stages are connected by queues of limited size, so loading and transformations overlap and
+memory stays bounded. each image is answered by one line (in order of completion):
+	{"index":..,"image":"..","objects":[...]}		or		{"index":..,"image":"..","error":".."}
+followed by the sustained throughput in images per second.
+tmplImg:	path to template image
+manifest:	path of a text file with one test image path per line
+*/
+void Aia3::batch(string tmplImg, string manifest) {
+
+	// processing parameter, same as for a single test image
+	double sigma = 1;		// standard deviation of directional gradient kernel
+	double templateThresh = 0.3;		// relative threshold for binarization of the template image
+	double objThresh = 0.53;		// relative threshold for maxima in hough space
+	double scaleSteps = 33;		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];				// scale of angles [min, max]
+	scaleRange[0] = 0.5;
+	scaleRange[1] = 2;
+	double angleSteps = 4;		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];				// range of angles [min, max)
+	angleRange[0] = 0;
+	angleRange[1] = 2 * CV_PI;
+	// pipeline parameter
+	int loaders = 2;		// number of threads loading test images
+	int queueSize = 4;		// capacity of the queues between the stages
+	double bankLimit = 1024;		// maximal memory in MB for keeping all template spectra (template bank)
+
+	// test image paths
+	vector<string> paths;
+	ifstream list(manifest.c_str());
+	if (!list) {
+		cerr << "ERROR: Cannot open manifest\n" << manifest << endl;
+		exit(-1);
+	}
+	for (string line; getline(list, line);) {
+		if (!line.empty() && (line[line.size() - 1] == '\r')) {
+			line.erase(line.size() - 1);
+		}
+		if (!line.empty()) {
+			paths.push_back(line);
+		}
+	}
+
+	Mat templateImage = imread(tmplImg, 0);
+	if (!templateImage.data) {
+		cerr << "ERROR: Cannot load template image from\n" << tmplImg << endl;
+		exit(-1);
+	}
+	templateImage.convertTo(templateImage, CV_32FC1);
+	vector<Mat> templ = makeObjectTemplate(templateImage, sigma, templateThresh);
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+
+	BoundedQueue<BatchItem> loaded(queueSize), transformed(queueSize), swept(queueSize);
+	int64 start = getTickCount();
+
+	// stage 1: load and convert to 32F, images are distributed over the loaders
+	mutex next;
+	size_t nextPath = 0;
+	vector<thread> loaderThreads;
+	for (int l = 0; l < loaders; l++) {
+		loaderThreads.push_back(thread([&] {
+			while (true) {
+				BatchItem item;
+				{
+					lock_guard<mutex> lock(next);
+					if (nextPath >= paths.size()) {
+						return;
+					}
+					item.index = (int)nextPath;
+					item.path = paths[nextPath++];
+				}
+				Mat image = imread(item.path, 0);
+				if (image.data) {
+					image.convertTo(item.testImage, CV_32FC1);
+				}
+				loaded.push(item);
+			}
+		}));
+	}
+	thread loadersDone([&] {
+		for (size_t l = 0; l < loaderThreads.size(); l++) {
+			loaderThreads[l].join();
+		}
+		loaded.close();
+	});
+
+	// stage 2: gradient and fourier transformation of the test image
+	thread transformer([&] {
+		BatchItem item;
+		while (loaded.pop(item)) {
+			if (!item.testImage.empty()) {
+				item.gradImage = calcDirectionalGrad(item.testImage, sigma);
+				imageSpectrum(item.gradImage, item.spectrum);
+			}
+			transformed.push(item);
+		}
+		transformed.close();
+	});
+
+	// stage 3: hough transform; template spectra are reused while the image size does not change
+	thread sweeper([&] {
+		// the bank belongs to this thread only, the template bank of the object is not touched
+		TemplateBank bank;
+		BatchItem item;
+		while (transformed.pop(item)) {
+			if (!item.testImage.empty()) {
+				double bankSize = poses.size() * item.spectrum.total() * 2 * sizeof(float) / (1024. * 1024.);
+				if (bankSize <= bankLimit) {
+					updateTemplateBank(templ, item.gradImage.size(), poses, bank);
+					houghSweep(item.spectrum, item.gradImage.size(), bank.templ, bank.poses, item.houghSpace, &bank.spectra);
+				}
+				else {
+					houghSweep(item.spectrum, item.gradImage.size(), templ, poses, item.houghSpace);
+				}
+				item.spectrum.release();
+			}
+			swept.push(item);
+		}
+		swept.close();
+	});
+
+	// stage 4: maxima search and refinement, in this thread
+	BatchItem item;
+	int images = 0;
+	while (swept.pop(item)) {
+		cout << "{\"index\":" << item.index << ",\"image\":" << jsonString(item.path) << ",";
+		if (item.testImage.empty()) {
+			cout << "\"error\":\"cannot load test image\"}" << endl;
+			continue;
+		}
+		vector<Scalar> objList;
+		vector<double> scores;
+		findHoughMaxima(item.houghSpace, objThresh, objList);
+		for (size_t i = 0; i < objList.size(); i++) {
+			scores.push_back(item.houghSpace.maxImage.at<float>((int)objList[i].val[3], (int)objList[i].val[2]));
+		}
+		refineHoughMaxima(item.gradImage, templ, item.houghSpace, scaleSteps, scaleRange, angleSteps, angleRange, objList);
+		cout << "\"objects\":" << objectRecords(objList, scores, scaleSteps, scaleRange, angleSteps, angleRange) << "}" << endl;
+		images++;
+	}
+
+	loadersDone.join();
+	transformer.join();
+	sweeper.join();
+
+	double seconds = (getTickCount() - start) / getTickFrequency();
+	cerr << images << " of " << paths.size() << " images in " << seconds << " s, " << images / seconds << " images per second" << endl;
+}
+
+// computes the full hough space of a test image into a file
+/*
+the file can be analyzed afterwards by inspectVolume(..), e.g. to tune the threshold of the maxima
+tmplImg:	path to template image
+testImg:	path to test image
+volumeFile:	path of the hough volume file
+depth:		depth of the stored planes, CV_32F or CV_16U (normalized per plane, half the size)
+*/
+void Aia3::writeVolume(string tmplImg, string testImg, string volumeFile, int depth) {
+
+	// processing parameter, same as for a single test image
+	double sigma = 1;		// standard deviation of directional gradient kernel
+	double templateThresh = 0.3;		// relative threshold for binarization of the template image
+	double scaleSteps = 33;		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];				// scale of angles [min, max]
+	scaleRange[0] = 0.5;
+	scaleRange[1] = 2;
+	double angleSteps = 4;		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];				// range of angles [min, max)
+	angleRange[0] = 0;
+	angleRange[1] = 2 * CV_PI;
+
+	Mat templateImage = imread(tmplImg, 0);
+	if (!templateImage.data) {
+		cerr << "ERROR: Cannot load template image from\n" << tmplImg << endl;
+		exit(-1);
+	}
+	templateImage.convertTo(templateImage, CV_32FC1);
+	Mat testImage = imread(testImg, 0);
+	if (!testImage.data) {
+		cerr << "ERROR: Cannot load test image from\n" << testImg << endl;
+		exit(-1);
+	}
+	testImage.convertTo(testImage, CV_32FC1);
+
+	vector<Mat> templ = makeObjectTemplate(templateImage, sigma, templateThresh);
+	Mat gradImage = calcDirectionalGrad(testImage, sigma);
+
+	HoughVolume volume = HoughVolume();
+	generalHough(gradImage, templ, scaleSteps, scaleRange, angleSteps, angleRange, volumeFile, depth, volume);
+	cout << "Hough volume: " << volume.header.scaleSteps << " scales x " << volume.header.angleSteps << " angles of " << volume.header.cols << "x" << volume.header.rows;
+	cout << ", " << volume.bytes / (1024. * 1024.) << " MB in " << volumeFile << endl;
+	closeHoughVolume(volume);
+}
+
+// detects objects in a hough volume file and shows its projection
+/*
+scales, angles and their ranges are read from the file
+volumeFile:	path of the hough volume file as written by writeVolume(..)
+objThresh:	relative threshold for maxima in hough space
+*/
+void Aia3::inspectVolume(string volumeFile, double objThresh) {
+
+	HoughVolume volume = HoughVolume();
+	openHoughVolume(volumeFile, volume);
+
+	vector<Scalar> objList;
+	findHoughMaxima(volume, objThresh, objList);
+	vector<double> scores;
+	Mat plane;
+	for (size_t i = 0; i < objList.size(); i++) {
+		volumePlane(volume, (int)objList[i].val[0], (int)objList[i].val[1], plane);
+		scores.push_back(plane.at<float>((int)objList[i].val[3], (int)objList[i].val[2]));
+	}
+	cout << "{\"objThresh\":" << objThresh << ",\"objects\":" << objectRecords(objList, scores, volume.header.scaleSteps, volume.header.scaleRange, volume.header.angleSteps, volume.header.angleRange) << "}" << endl;
+
+	plotHough(volume);
+	closeHoughVolume(volume);
+}
+
+// measures the stages of the hough transform on synthetic scenes and prints one record per scene configuration
+/*
+scenes contain rotated and scaled copies of the template image (see rotateAndScale(..)) at grid poses and random
+positions; size 0 creates the single centered object of makeTestImage(..). the times of all stages are medians over
+the repetitions. options (key=value, lists separated by commas):
+	sizes		image sizes (square, 0: size of makeTestImage(..))		default 0,1024
+	objects		number of objects per scene								default 1,4
+	scaleSteps, scaleMin, scaleMax, angleSteps							default 9, 0.5, 2, 8
+	objThresh	relative threshold for maxima in hough space			default 0.53
+	repeats		repetitions per configuration							default 3
+	seed		seed of the object poses and positions					default 0
+records:
+	{"size":[cols,rows],"objects":..,"poses":..,"template_ms":..,"grad_ms":..,"hough_ms":..,"maxima_ms":..,
+	 "ffts":..,"mpix_poses_per_s":..,"images_per_s":..,"process_peak_rss_mb":..,"precision":..,"recall":..,"position_error":..}
+process_peak_rss_mb is the peak resident memory of the whole process so far, i.e. of all configurations up to this
+record and not of this configuration alone; it only grows from record to record (0 on Windows)
+detections match an object if they are within 3 pixels and one scale and angle step of it; each object is matched by one
+detection at most, further detections of it count as false positives
+tmplImg:	path to template image
+options:	the options
+*/
+void Aia3::benchmark(string tmplImg, const vector<string>& options) {
 
-	Mat params = (Mat_<float>(1, 9) << sigma, templateThresh, objThresh, scaleSteps, scaleRange[0], scaleRange[1], angleSteps, angleRange[0], angleRange[1]);
+	// processing parameter
+	double sigma = 1;		// standard deviation of directional gradient kernel
+	double templateThresh = 0.3;		// relative threshold for binarization of the template image
+	double objThresh = 0.53;		// relative threshold for maxima in hough space
+	double scaleSteps = 9;		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2] = {0.5, 2};		// scale of angles [min, max]
+	double angleSteps = 8;		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2] = {0, 2 * CV_PI};		// range of angles [min, max)
+	// benchmark parameter
+	vector<int> sizes, objects;
+	int repeats = 3;
+	int seed = 0;
+
+	for (size_t i = 0; i < options.size(); i++) {
+		size_t eq = options[i].find('=');
+		string key = options[i].substr(0, eq), value = (eq == string::npos) ? "" : options[i].substr(eq + 1);
+		vector<int> list;
+		istringstream items(value);
+		for (string item; getline(items, item, ',');) {
+			list.push_back(atoi(item.c_str()));
+		}
+		if (key == "sizes") sizes = list;
+		else if (key == "objects") objects = list;
+		else if (key == "scaleSteps") scaleSteps = atof(value.c_str());
+		else if (key == "scaleMin") scaleRange[0] = atof(value.c_str());
+		else if (key == "scaleMax") scaleRange[1] = atof(value.c_str());
+		else if (key == "angleSteps") angleSteps = atof(value.c_str());
+		else if (key == "objThresh") objThresh = atof(value.c_str());
+		else if (key == "repeats") repeats = std::max(atoi(value.c_str()), 1);
+		else if (key == "seed") seed = atoi(value.c_str());
+		else {
+			cerr << "ERROR: Unknown benchmark option\n" << options[i] << endl;
+			exit(-1);
+		}
+	}
+	string invalid = checkHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange);
+	if (!invalid.empty()) {
+		cerr << "ERROR: " << invalid << endl;
+		exit(-1);
+	}
+	if (sizes.empty()) {
+		sizes.push_back(0);
+		sizes.push_back(1024);
+	}
+	if (objects.empty()) {
+		objects.push_back(1);
+		objects.push_back(4);
+	}
 
-	// load template image as gray-scale, paths in argv[1]
 	Mat templateImage = imread(tmplImg, 0);
 	if (!templateImage.data) {
 		cerr << "ERROR: Cannot load template image from\n" << tmplImg << endl;
-		cerr << "Press enter..." << endl;
-		cin.get();
 		exit(-1);
 	}
-	// convert 8U to 32F
 	templateImage.convertTo(templateImage, CV_32FC1);
-	// show template image
-	showImage(templateImage, "Template image", 0);
 
-	// load test image
-	Mat testImage = imread(testImg, 0);
-	if (!testImage.data) {
-		cerr << "ERROR: Cannot load test image from\n" << testImg << endl;
-		cerr << "Press enter..." << endl;
-		cin.get();
-		exit(-1);
-	}
-	// and convert it from 8U to 32F
-	testImage.convertTo(testImage, CV_32FC1);
-	// show test image
-	showImage(testImage, "testImage", 0);
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+	bool periodic = fabs(angleRange[1] - angleRange[0] - 2 * CV_PI) < 1e-6;
+	RNG rng(seed);
 
-	// start processing
-	process(templateImage, testImage, params);
+	// median of repeated measurements
+	auto median = [](vector<double> values) {
+		sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	};
+
+	for (size_t si = 0; si < sizes.size(); si++) {
+		for (size_t oi = 0; oi < objects.size(); oi++) {
+
+			int size = sizes[si];
+			int numObjects = (size == 0) ? 1 : objects[oi];
+			if ((size == 0) && (oi > 0)) {
+				continue;
+			}
+
+			// scene and ground truth (pose index and center)
+			Mat testImage;
+			vector<Vec3i> truth;
+			if (size == 0) {
+				const HoughPose& pose = poses[rng.uniform(0, (int)poses.size())];
+				testImage = makeTestImage(templateImage, pose.angle, pose.scale, scaleRange);
+				Mat small = rotateAndScale(templateImage, pose.angle, pose.scale);
+				int x = (int)((testImage.cols - small.cols) * 0.5) + small.cols / 2;
+				int y = (int)((testImage.rows - small.rows) * 0.5) + small.rows / 2;
+				truth.push_back(Vec3i(pose.scaleIdx * (int)angleSteps + pose.angleIdx, x, y));
+			}
+			else {
+				// one object per grid cell, at a random position within its cell
+				testImage = Mat::zeros(size, size, CV_32FC1);
+				int cells = (int)ceil(sqrt((double)numObjects));
+				int cellSize = size / cells;
+				for (int n = 0; n < numObjects; n++) {
+					const HoughPose& pose = poses[rng.uniform(0, (int)poses.size())];
+					Mat small = rotateAndScale(templateImage, pose.angle, pose.scale);
+					int freeX = cellSize - small.cols, freeY = cellSize - small.rows;
+					if ((freeX < 0) || (freeY < 0)) {
+						cerr << "ERROR: objects do not fit into an image of size " << size << endl;
+						exit(-1);
+					}
+					Rect roi((n % cells) * cellSize + rng.uniform(0, freeX + 1), (n / cells) * cellSize + rng.uniform(0, freeY + 1), small.cols, small.rows);
+					Mat target = testImage(roi);
+					max(target, small, target);
+					truth.push_back(Vec3i(pose.scaleIdx * (int)angleSteps + pose.angleIdx, roi.x + small.cols / 2, roi.y + small.rows / 2));
+				}
+			}
+
+			// stages
+			vector<double> templateTimes, gradTimes, houghTimes, maximaTimes;
+			long long ffts = 0;
+			vector<Scalar> objList;
+			for (int r = 0; r < repeats; r++) {
+				int64 t0 = getTickCount();
+				vector<Mat> templ = makeObjectTemplate(templateImage, sigma, templateThresh);
+				int64 t1 = getTickCount();
+				Mat gradImage = calcDirectionalGrad(testImage, sigma);
+				int64 t2 = getTickCount();
+				Fft::resetCount();
+				ReducedHough houghSpace;
+				generalHough(gradImage, templ, poses, houghSpace);
+				ffts = Fft::getCount();
+				int64 t3 = getTickCount();
+				objList.clear();
+				findHoughMaxima(houghSpace, objThresh, objList);
+				int64 t4 = getTickCount();
+
+				double ms = 1000. / getTickFrequency();
+				templateTimes.push_back((t1 - t0) * ms);
+				gradTimes.push_back((t2 - t1) * ms);
+				houghTimes.push_back((t3 - t2) * ms);
+				maximaTimes.push_back((t4 - t3) * ms);
+			}
+
+			// accuracy against ground truth: each detection matches the closest object not matched before
+			int matchedTruth = 0;
+			double positionError = 0;
+			vector<bool> used(truth.size(), false);
+			for (size_t d = 0; d < objList.size(); d++) {
+				int i = (int)objList[d].val[0], j = (int)objList[d].val[1];
+				int best = -1;
+				double bestDist = 0;
+				for (size_t t = 0; t < truth.size(); t++) {
+					if (used[t]) {
+						continue;
+					}
+					int ti = truth[t][0] / (int)angleSteps, tj = truth[t][0] % (int)angleSteps;
+					int dj = abs(j - tj);
+					if (periodic) {
+						dj = std::min(dj, (int)angleSteps - dj);
+					}
+					double dist = sqrt(pow(objList[d].val[2] - truth[t][1], 2) + pow(objList[d].val[3] - truth[t][2], 2));
+					if ((abs(i - ti) <= 1) && (dj <= 1) && (dist <= 3) && ((best < 0) || (dist < bestDist))) {
+						best = (int)t;
+						bestDist = dist;
+					}
+				}
+				// detections of an already matched object are false positives
+				if (best >= 0) {
+					used[best] = true;
+					matchedTruth++;
+					positionError += bestDist;
+				}
+			}
 
+			// peak resident memory of the process since its start, not of this configuration
+			double peakRss = 0;
+#ifndef _WIN32
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+			peakRss = usage.ru_maxrss / (1024. * 1024.);
+#else
+			peakRss = usage.ru_maxrss / 1024.;
+#endif
+#endif
+
+			double total = median(gradTimes) + median(houghTimes) + median(maximaTimes);
+			cout << "{\"size\":[" << testImage.cols << "," << testImage.rows << "],\"objects\":" << numObjects << ",\"poses\":" << poses.size();
+			cout << ",\"template_ms\":" << median(templateTimes) << ",\"grad_ms\":" << median(gradTimes);
+			cout << ",\"hough_ms\":" << median(houghTimes) << ",\"maxima_ms\":" << median(maximaTimes);
+			cout << ",\"ffts\":" << ffts << ",\"mpix_poses_per_s\":" << testImage.total() * poses.size() / (median(houghTimes) * 1000.);
+			cout << ",\"images_per_s\":" << 1000. / total << ",\"process_peak_rss_mb\":" << peakRss;
+			cout << ",\"precision\":" << (objList.empty() ? 0. : (double)matchedTruth / objList.size());
+			cout << ",\"recall\":" << (double)matchedTruth / truth.size();
+			cout << ",\"position_error\":" << (matchedTruth > 0 ? positionError / matchedTruth : -1.) << "}" << endl;
+		}
+	}
 }
 
 // loads template and create test image, sets parameters and calls processing routine
@@ -364,6 +3368,9 @@ void Aia3::test(string tmplImg, float angle, float scale) {
 	// show template image
 	showImage(templateImage, "Template Image", 0);
 
+	test_fft();
+	test_octaveHough(templateImage);
+
 	// generate test image
 	Mat testImage = makeTestImage(templateImage, testAngle, testScale, scaleRange);
 	// show test image
@@ -373,6 +3380,89 @@ void Aia3::test(string tmplImg, float angle, float scale) {
 	process(templateImage, testImage, params);
 }
 
+void Aia3::test_fft(void) {
+
+	// image sizes with radix 2, 3 and 5, small primes and large primes (Bluestein's algorithm)
+	int sizes[5][2] = { {64, 64}, {120, 90}, {91, 77}, {67, 101}, {34, 211} };
+	int depths[2] = { CV_32F, CV_64F };
+	RNG rng(0);
+	for (int i = 0; i < 5; i++) {
+		Mat image(sizes[i][0], sizes[i][1], CV_32FC2), templ(sizes[i][0], sizes[i][1], CV_32FC2);
+		rng.fill(image, RNG::UNIFORM, -1, 1);
+		rng.fill(templ, RNG::UNIFORM, -1, 1);
+
+		// spectra and correlation by cv::dft(..)
+		Mat expected, templSpectrum, product, expectedCorr;
+		dft(image, expected, DFT_COMPLEX_OUTPUT);
+		dft(templ, templSpectrum, DFT_COMPLEX_OUTPUT);
+		mulSpectrums(expected, templSpectrum, product, 0, true);
+		dft(product, expectedCorr, DFT_INVERSE | DFT_SCALE | DFT_REAL_OUTPUT);
+		expectedCorr = abs(expectedCorr);
+
+		for (int d = 0; d < 2; d++) {
+			Mat spectrum, work, corr(image.rows, image.cols, CV_32FC1);
+			Fft::dft(image, spectrum, DFT_COMPLEX_OUTPUT, depths[d]);
+			Fft::correlate(expected, templSpectrum, work, image.size(), [&corr](int y, const float* values) {
+				memcpy(corr.ptr<float>(y), values, corr.cols * sizeof(float));
+			}, depths[d]);
+			if ((norm(spectrum, expected, NORM_INF) > 1e-4 * norm(expected, NORM_INF)) || (norm(corr, expectedCorr, NORM_INF) > 1e-4 * norm(expectedCorr, NORM_INF))) {
+				cout << "There might be a problem with Fft::dft(..) or Fft::correlate(..):" << endl;
+				cout << "\tThe " << ((depths[d] == CV_64F) ? "double" : "single") << " precision result for " << sizes[i][1] << "x" << sizes[i][0] << " differs from cv::dft(..)" << endl;
+				cin.get();
+			}
+		}
+	}
+
+	// speed compared to cv::dft(..)
+	Mat image(1024, 1024, CV_32FC1), spectrum;
+	rng.fill(image, RNG::UNIFORM, -1, 1);
+	cout << "Fourier transformation of 1024x1024:";
+	for (int d = 0; d < 2; d++) {
+		// the first transformation creates the plans
+		Fft::dft(image, spectrum, DFT_COMPLEX_OUTPUT, depths[d]);
+		int64 start = getTickCount();
+		Fft::dft(image, spectrum, DFT_COMPLEX_OUTPUT, depths[d]);
+		cout << " " << ((depths[d] == CV_64F) ? "double" : "single") << " precision " << (getTickCount() - start) * 1000. / getTickFrequency() << " ms,";
+	}
+	dft(image, spectrum, DFT_COMPLEX_OUTPUT);
+	int64 start = getTickCount();
+	dft(image, spectrum, DFT_COMPLEX_OUTPUT);
+	cout << " cv::dft(..) " << (getTickCount() - start) * 1000. / getTickFrequency() << " ms" << endl;
+}
+
+void Aia3::test_octaveHough(const Mat& templateImage) {
+
+	// one object at a scale of the second octave
+	double scaleRange[2] = { 0.5, 2 };
+	double angleRange[2] = { 0, 2 * CV_PI };
+	Mat testImage = makeTestImage(templateImage, 0, 1.5, scaleRange);
+
+	vector<Mat> templ = makeObjectTemplate(templateImage, 1, 0.7);
+	vector<HoughPose> poses;
+	makeHoughPoses(3, scaleRange, 4, angleRange, poses);
+	ReducedHough houghSpace;
+	octaveHough(testImage, templ, 1, poses, houghSpace);
+
+	vector<Scalar> objList;
+	findHoughMaxima(houghSpace, 0.85, objList);
+	if (objList.size() != 1) {
+		cout << "There might be a problem with Aia3::octaveHough(..):" << endl;
+		cout << "\t" << objList.size() << " objects were found in a test image with a single object" << endl;
+		cin.get();
+		return;
+	}
+
+	// the object is centered at scale 1.5, i.e. scale index 2; positions of the second octave are accurate up to
+	// 2 pixels, plus one for the rounded size of the object
+	Scalar obj = objList[0];
+	if ((obj.val[0] != 2) || (fabs(obj.val[2] - testImage.cols / 2) > 3) || (fabs(obj.val[3] - testImage.rows / 2) > 3)) {
+		cout << "There might be a problem with Aia3::octaveHough(..):" << endl;
+		cout << "\tThe object was found at (" << obj.val[2] << ", " << obj.val[3] << ") with scale index " << obj.val[0];
+		cout << " instead of (" << testImage.cols / 2 << ", " << testImage.rows / 2 << ") with scale index 2" << endl;
+		cin.get();
+	}
+}
+
 void Aia3::process(const Mat& templateImage, const Mat& testImage, const Mat& params) {
 
 	// processing parameter
@@ -387,6 +3477,20 @@ void Aia3::process(const Mat& templateImage, const Mat& testImage, const Mat& pa
 	double angleRange[2];								// range of angles [min, max)
 	angleRange[0] = params.at<float>(7);
 	angleRange[1] = params.at<float>(8);
+	double bankLimit = 1024;		// maximal memory in MB for keeping all template spectra (template bank)
+	bool sparseVote = false;		// approximate the hough transform by sparse voting where it is estimated to be cheaper (see vote(..))
+	double edgeThresh = 0.1;		// relative threshold on gradient magnitude of test image edges used for sparse voting
+	int pyramidLevels = 0;		// number of coarse-to-fine pyramid levels (0: search on full resolution only)
+	double tileLimit = 16;		// test images with more megapixels are processed tile by tile
+	double roiThresh = 0;		// edge density prefilter: positions with less than this fraction of the maximal edge sum within the template footprint are skipped (0: off)
+	double memoryLimit = 0;		// memory cap in MB; tile size, concurrent jobs and precision are chosen to stay below (0: unlimited)
+	int harmonics = 0;		// number of circular harmonics for the angle dimension (0: rotate template for each angle)
+	int adaptiveLevels = 0;		// adaptive refinement of the scale/angle grid, coarsest step is 2^adaptiveLevels bins (0: full grid)
+	int adaptiveCells = 8;		// number of best scale/angle cells refined per step
+	bool octaves = false;		// search large scales on a downsampled test image (octave pyramid over the scale dimension)
+	bool refine = false;		// refine detected objects to sub-bin precision of scale, angle and position
+	bool prune = false;		// pre-estimate scale and rotation by fourier-mellin transform (single object scenes)
+	int pruneBand = 2;		// number of neighboring scale and angle steps searched around each estimate
 
 	// calculate directional gradient of test image as complex numbers (two channel image)
 	Mat gradImage = calcDirectionalGrad(testImage, sigma);
@@ -400,7 +3504,92 @@ void Aia3::process(const Mat& templateImage, const Mat& testImage, const Mat& pa
 	showImage(templ[0], "Binary part of template", 0);
 
 	// perfrom general hough transformation
-	vector< vector<Mat> > houghSpace = generalHough(gradImage, templ, scaleSteps, scaleRange, angleSteps, angleRange);
+	// only maximum and argmax over scales and angles are kept
+	ReducedHough houghSpace;
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+	if (prune) {
+		// search only in a narrow band around the estimated scales and rotations
+		vector<Vec2d> candidates;
+		fourierMellin(templ[1], gradImage, 2, candidates);
+		bandHoughPoses(candidates, pruneBand, scaleSteps, scaleRange, angleSteps, angleRange, poses);
+		cout << "Fourier-Mellin: " << poses.size() << " of " << scaleSteps * angleSteps << " poses" << endl;
+	}
+	double bankSize = poses.size() * gradImage.total() * 2 * sizeof(float) / (1024. * 1024.);
+	bool tiled = gradImage.total() > tileLimit * 1024 * 1024;
+	bool bank = bankSize <= bankLimit;
+	int tileSize = 0;
+	// defaults unless a memory plan is made: one job per thread, single precision as cv::dft(..)
+	maxJobs = 0;
+	fftDepth = CV_32F;
+	if (memoryLimit > 0) {
+		// schedule the hough transform within the memory limit
+		HoughPlan plan;
+		bool fits = planHough(gradImage.size(), templ, poses, memoryLimit, bankLimit, tiled, plan);
+		tiled = plan.tileSize > 0;
+		bank = plan.bank;
+		tileSize = plan.tileSize;
+		maxJobs = plan.jobs;
+		fftDepth = plan.fftDepth;
+		cout << "Memory plan: ";
+		if (tiled) {
+			cout << "tiles of " << plan.tileSize << "x" << plan.tileSize;
+		}
+		else {
+			cout << "whole image";
+		}
+		cout << ", " << plan.jobs << " concurrent jobs, " << (plan.bank ? "template bank" : "spectra on the fly");
+		cout << ", " << ((plan.fftDepth == CV_64F) ? "double" : "single") << " precision fft";
+		cout << ", about " << plan.memory << " MB of " << memoryLimit << " MB" << endl;
+		if (!fits) {
+			cerr << "WARNING: the hough transform does not fit into the memory limit" << endl;
+		}
+	}
+	// sparse voting is considered only if asked for, and neither prefilter, tiling nor memory plan were asked for
+	bool explicitEngine = (roiThresh > 0) || tiled || (memoryLimit > 0);
+	if (pyramidLevels > 0) {
+		// coarse-to-fine search on an image pyramid
+		pyramidHough(testImage, templ, sigma, scaleSteps, scaleRange, angleSteps, angleRange, pyramidLevels, objThresh, houghSpace);
+	}
+	else if (harmonics > 0) {
+		// fourier transformations per scale only, angles are synthesized from circular harmonics
+		harmonicHough(gradImage, templ, poses, harmonics, houghSpace);
+	}
+	else if (octaves) {
+		// scales of each octave on the accordingly downsampled image
+		int spectra = octaveHough(testImage, templ, sigma, poses, houghSpace);
+		cout << "Octave pyramid: " << spectra << " template spectra for " << poses.size() << " poses (" << poses.size() - spectra << " reused)" << endl;
+	}
+	else if (adaptiveLevels > 0) {
+		// coarse scale/angle grid, refined only around the best cells
+		adaptiveHough(gradImage, templ, scaleSteps, scaleRange, angleSteps, angleRange, adaptiveLevels, adaptiveCells, houghSpace);
+	}
+	else if (sparseVote && !explicitEngine && preferHoughVote(gradImage, templ, poses, edgeThresh, bank)) {
+		// few edges: sparse voting is cheaper than correlation in the frequency domain
+		cout << "Hough transform by sparse voting" << endl;
+		houghVote(gradImage, templ, poses, edgeThresh, houghSpace);
+	}
+	else if (roiThresh > 0) {
+		// correlate only tiles containing enough edges
+		Mat candidates;
+		edgeCandidates(gradImage, templ, poses, roiThresh, candidates);
+		int tiles = tiledHough(gradImage, templ, poses, tileSize, houghSpace, &candidates);
+		cout << "Edge density prefilter: " << tiles << " tiles correlated" << endl;
+	}
+	else if (tiled) {
+		// large test image: fourier transformations of tile size only
+		tiledHough(gradImage, templ, poses, tileSize, houghSpace);
+	}
+	else if (bank) {
+		// template spectra are computed only once and reused for following test images
+		updateTemplateBank(templ, gradImage.size(), poses, templateBank);
+		generalHough(gradImage, templateBank, houghSpace);
+	}
+	else {
+		// spectra would not fit into memory: compute them on the fly
+		templateBank = TemplateBank();
+		generalHough(gradImage, templ, poses, houghSpace);
+	}
 
 	// plot hough space (max over angle- and scale-dimension)
 	plotHough(houghSpace);
@@ -408,12 +3597,15 @@ void Aia3::process(const Mat& templateImage, const Mat& testImage, const Mat& pa
 	// find maxima in hough space
 	vector<Scalar> objList;
 	findHoughMaxima(houghSpace, objThresh, objList);
+	if (refine) {
+		refineHoughMaxima(gradImage, templ, houghSpace, scaleSteps, scaleRange, angleSteps, angleRange, objList);
+	}
 
 	// print found objects on screen
 	cout << "Number of objects: " << objList.size() << endl;
 	int i = 0;
 	for (vector<Scalar>::const_iterator it = objList.begin(); it != objList.end(); it++, i++) {
-		cout << i << "\tScale:\t" << (scaleRange[1] - scaleRange[0]) / (scaleSteps - 1)*(*it).val[0] + scaleRange[0];
+		cout << i << "\tScale:\t" << (scaleRange[1] - scaleRange[0]) / scaleSteps * (*it).val[0] + scaleRange[0];
 
 		cout << "\tAngle:\t" << ((angleRange[1] - angleRange[0]) / (angleSteps)*(*it).val[1] + angleRange[0]) / CV_PI * 180;
 		cout << "\tPosition:\t(" << (*it).val[2] << ", " << (*it).val[3] << " )" << endl;
@@ -422,6 +3614,160 @@ void Aia3::process(const Mat& templateImage, const Mat& testImage, const Mat& pa
 	// show final detection result
 	plotHoughDetectionResult(testImage, templ, objList, scaleSteps, scaleRange, angleSteps, angleRange);
 
+	// the memory plan applies to this call only, later detections start from the defaults again
+	maxJobs = 0;
+	fftDepth = CV_32F;
+}
+
+// formats a list of objects as records, at the scales and angles of the hough grid (see makeHoughPoses(..))
+/*
+objList:	list of objects, as found by findHoughMaxima(..) and refined by refineHoughMaxima(..)
+scores:		hough response of each object
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+return:		[{"scale":..,"angle":..,"x":..,"y":..,"score":..},...], angles in degree
+*/
+string Aia3::objectRecords(const vector<Scalar>& objList, const vector<double>& scores, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange) {
+
+	ostringstream out;
+	out << "[";
+	for (size_t i = 0; i < objList.size(); i++) {
+		out << ((i > 0) ? "," : "");
+		out << "{\"scale\":" << (scaleRange[1] - scaleRange[0]) / scaleSteps * objList[i].val[0] + scaleRange[0];
+		out << ",\"angle\":" << ((angleRange[1] - angleRange[0]) / angleSteps * objList[i].val[1] + angleRange[0]) / CV_PI * 180;
+		out << ",\"x\":" << objList[i].val[2] << ",\"y\":" << objList[i].val[3] << ",\"score\":" << scores[i] << "}";
+	}
+	out << "]";
+	return out.str();
+}
+
+// quotes a string for json output
+/*
+quotes and backslashes are escaped, control characters are written as \uXXXX (or \n, \r, \t)
+text:		the string
+return:		the quoted string
+*/
+string Aia3::jsonString(const string& text) {
+
+	ostringstream out;
+	out << "\"";
+	for (size_t i = 0; i < text.size(); i++) {
+		unsigned char c = text[i];
+		if ((c == '"') || (c == '\\')) out << '\\' << c;
+		else if (c == '\n') out << "\\n";
+		else if (c == '\r') out << "\\r";
+		else if (c == '\t') out << "\\t";
+		else if (c < 0x20) out << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 15];
+		else out << c;
+	}
+	out << "\"";
+	return out.str();
+}
+
+// detects objects in a test image without any visualization
+/*
+same hough transform as process(..) with a template bank, followed by maxima search and refinement
+testImage:	the test image (CV_32FC1)
+templ:		the template consisting of binary image and complex-valued directional gradient image
+params:		the parameters as for process(..)
+bank:		the template bank; rebuilt only if template, image size or poses change
+objList:	list of detected objects, as refined by refineHoughMaxima(..)
+scores:		hough response of each object
+*/
+void Aia3::detect(const Mat& testImage, const vector<Mat>& templ, const Mat& params, TemplateBank& bank, vector<Scalar>& objList, vector<double>& scores) {
+
+	// processing parameter
+	double sigma = params.at<float>(0);		// standard deviation of directional gradient kernel
+	double objThresh = params.at<float>(2);		// relative threshold for maxima in hough space
+	double scaleSteps = params.at<float>(3);		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];								// scale of angles [min, max]
+	scaleRange[0] = params.at<float>(4);
+	scaleRange[1] = params.at<float>(5);
+	double angleSteps = params.at<float>(6);		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];								// range of angles [min, max)
+	angleRange[0] = params.at<float>(7);
+	angleRange[1] = params.at<float>(8);
+	double bankLimit = 1024;		// maximal memory in MB for keeping all template spectra (template bank)
+
+	Mat gradImage = calcDirectionalGrad(testImage, sigma);
+
+	ReducedHough houghSpace;
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+	double bankSize = poses.size() * gradImage.total() * 2 * sizeof(float) / (1024. * 1024.);
+	if (bankSize <= bankLimit) {
+		updateTemplateBank(templ, gradImage.size(), poses, bank);
+		generalHough(gradImage, bank, houghSpace);
+	}
+	else {
+		bank = TemplateBank();
+		generalHough(gradImage, templ, poses, houghSpace);
+	}
+
+	objList.clear();
+	findHoughMaxima(houghSpace, objThresh, objList);
+	scores.clear();
+	for (size_t i = 0; i < objList.size(); i++) {
+		scores.push_back(houghSpace.maxImage.at<float>((int)objList[i].val[3], (int)objList[i].val[2]));
+	}
+	refineHoughMaxima(gradImage, templ, houghSpace, scaleSteps, scaleRange, angleSteps, angleRange, objList);
+}
+
+// detects several templates in one test image
+/*
+gradient and fourier-spectrum of the test image are computed only once and shared by all templates;
+template spectra are kept in one template bank per template
+templateImages:	the template images
+testImage:		the test image
+params:			processing parameters, same as for a single template
+objLists:		list of detected objects (as defined by findHoughMaxima(..)) for each template
+*/
+void Aia3::process(const vector<Mat>& templateImages, const Mat& testImage, const Mat& params, vector< vector<Scalar> >& objLists) {
+
+	// processing parameter
+	double sigma = params.at<float>(0);		// standard deviation of directional gradient kernel
+	double templateThresh = params.at<float>(1);		// relative threshold for binarization of the template image
+	double objThresh = params.at<float>(2);		// relative threshold for maxima in hough space
+	double scaleSteps = params.at<float>(3);		// scale resolution in terms of number of scales to be investigated
+	double scaleRange[2];								// scale of angles [min, max]
+	scaleRange[0] = params.at<float>(4);
+	scaleRange[1] = params.at<float>(5);
+	double angleSteps = params.at<float>(6);		// angle resolution in terms of number of angles to be investigated
+	double angleRange[2];								// range of angles [min, max)
+	angleRange[0] = params.at<float>(7);
+	angleRange[1] = params.at<float>(8);
+	double bankLimit = 1024;		// maximal memory in MB for keeping all template spectra (all template banks)
+
+	// gradient of the test image and its spectrum, shared by all templates
+	Mat gradImage = calcDirectionalGrad(testImage, sigma);
+	Mat spectrum;
+	imageSpectrum(gradImage, spectrum);
+
+	vector<HoughPose> poses;
+	makeHoughPoses(scaleSteps, scaleRange, angleSteps, angleRange, poses);
+	double bankSize = templateImages.size() * poses.size() * gradImage.total() * 2 * sizeof(float) / (1024. * 1024.);
+	templateBanks.resize(templateImages.size());
+
+	objLists.assign(templateImages.size(), vector<Scalar>());
+	for (size_t t = 0; t < templateImages.size(); t++) {
+
+		vector<Mat> templ = makeObjectTemplate(templateImages[t], sigma, templateThresh);
+
+		ReducedHough houghSpace;
+		if (bankSize <= bankLimit) {
+			// per pose only spectrum multiplication and inverse fourier transformation
+			updateTemplateBank(templ, gradImage.size(), poses, templateBanks[t]);
+			houghSweep(spectrum, gradImage.size(), templateBanks[t].templ, templateBanks[t].poses, houghSpace, &templateBanks[t].spectra);
+		}
+		else {
+			templateBanks[t] = TemplateBank();
+			houghSweep(spectrum, gradImage.size(), templ, poses, houghSpace);
+		}
+
+		findHoughMaxima(houghSpace, objThresh, objLists[t]);
+	}
 }
 // computes directional gradients
 /*
@@ -436,35 +3782,175 @@ Mat Aia3::calcDirectionalGrad(const Mat& image, double sigma) {
 	if (ksize % 2 == 0)  ksize++;
 	double mu = ksize / 2.0;
 
-	// generate kernels for x- and y-direction
-	double val, sum = 0;
-	Mat kernel(ksize, ksize, CV_32FC1);
-	//Mat kernel_y(ksize, ksize, CV_32FC1);
-	for (int i = 0; i<ksize; i++) {
-		for (int j = 0; j<ksize; j++) {
-			val = pow((i + 0.5 - mu) / sigma, 2);
-			val += pow((j + 0.5 - mu) / sigma, 2);
-			val = exp(-0.5*val);
-			sum += val;
-			kernel.at<float>(i, j) = -(j + 0.5 - mu)*val;
-		}
+	// generate 1D kernels; the 2D kernel is separable into the derivative of gaussian
+	// along the gradient direction and the gaussian orthogonal to it
+	double val, sum = 0, moment = 0;
+	Mat smooth(1, ksize, CV_32FC1);
+	Mat deriv(1, ksize, CV_32FC1);
+	for (int j = 0; j<ksize; j++) {
+		val = exp(-0.5*pow((j + 0.5 - mu) / sigma, 2));
+		sum += val;
+		moment += pow(j + 0.5 - mu, 2)*val;
+		smooth.at<float>(j) = val;
+		deriv.at<float>(j) = -(j + 0.5 - mu)*val;
 	}
-	kernel /= sum;
-
-	// use those kernels to compute gradient in x- and y-direction independently
-	vector<Mat> grad(2);
-	filter2D(image, grad[0], -1, kernel);
-	filter2D(image, grad[1], -1, kernel.t());
+	smooth /= sum;
+	deriv /= sum;
 
+	Mat input;
+	image.convertTo(input, CV_32FC1);
 
 	// combine both real-valued gradient images to a single complex-valued image
-	Mat output;
+	Mat output(input.rows, input.cols, CV_32FC2);
 
-	merge(grad, output);
+	if (ksize > 15) {
+		// large kernels: recursive filter, costs do not depend on sigma
+		// scaled such that a linear ramp has the same response as with the kernel above
+		recursiveDirectionalGrad(input, sigma, moment / sum, output);
+	}
+	else {
+		separableDirectionalGrad(input, smooth, deriv, output);
+	}
 
 	return output;
 }
 
+// computes directional gradients with separable kernels
+/*
+both gradient directions are computed in one horizontal and one vertical pass; same result as filtering
+with the 2D kernels (border handling as in filter2D)
+image:	the input image (CV_32FC1)
+smooth:	1D gaussian kernel
+deriv:	1D derivative of gaussian kernel
+output:	the two-channel gradient image (CV_32FC2, initialized outside of this function)
+*/
+void Aia3::separableDirectionalGrad(const Mat& image, const Mat& smooth, const Mat& deriv, Mat& output) {
+
+	int ksize = smooth.cols;
+	int r = ksize / 2;
+	const float* s = smooth.ptr<float>(0);
+	const float* d = deriv.ptr<float>(0);
+
+	Mat padded;
+	copyMakeBorder(image, padded, r, r, r, r, BORDER_REFLECT_101);
+
+	// horizontal pass: smoothed and differentiated rows
+	Mat rowSmooth = Mat::zeros(padded.rows, image.cols, CV_32FC1);
+	Mat rowDeriv = Mat::zeros(padded.rows, image.cols, CV_32FC1);
+	for (int y = 0; y < padded.rows; y++) {
+		const float* in = padded.ptr<float>(y);
+		float* hs = rowSmooth.ptr<float>(y);
+		float* hd = rowDeriv.ptr<float>(y);
+		for (int j = 0; j < ksize; j++) {
+			for (int x = 0; x < image.cols; x++) {
+				hs[x] += s[j] * in[x + j];
+				hd[x] += d[j] * in[x + j];
+			}
+		}
+	}
+
+	// vertical pass: x-gradient smoothed along columns, y-gradient differentiated along columns
+	Mat gx(1, image.cols, CV_32FC1), gy(1, image.cols, CV_32FC1);
+	float* ax = gx.ptr<float>(0);
+	float* ay = gy.ptr<float>(0);
+	for (int y = 0; y < image.rows; y++) {
+		gx.setTo(0);
+		gy.setTo(0);
+		for (int i = 0; i < ksize; i++) {
+			const float* hs = rowSmooth.ptr<float>(y + i);
+			const float* hd = rowDeriv.ptr<float>(y + i);
+			for (int x = 0; x < image.cols; x++) {
+				ax[x] += s[i] * hd[x];
+				ay[x] += d[i] * hs[x];
+			}
+		}
+		Vec2f* out = output.ptr<Vec2f>(y);
+		for (int x = 0; x < image.cols; x++) {
+			out[x][0] = ax[x];
+			out[x][1] = ay[x];
+		}
+	}
+}
+
+// computes directional gradients with a recursive gaussian filter
+/*
+the image is smoothed by the third order recursive filter of Young and van Vliet (forward and backward pass
+in each direction) and differentiated by central differences; approximates the (untruncated) derivative of gaussian
+image:	the input image (CV_32FC1)
+sigma:	standard deviation of the gaussian
+gain:	factor applied to the derivative
+output:	the two-channel gradient image (CV_32FC2, initialized outside of this function)
+*/
+void Aia3::recursiveDirectionalGrad(const Mat& image, double sigma, double gain, Mat& output) {
+
+	// filter coefficients
+	double q = (sigma >= 2.5) ? 0.98711*sigma - 0.96330 : 3.97156 - 4.14554*sqrt(1 - 0.26891*sigma);
+	double b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+	double b1 = (2.44413*q + 2.85619*q*q + 1.26661*q*q*q) / b0;
+	double b2 = -(1.4281*q*q + 1.26661*q*q*q) / b0;
+	double b3 = 0.422205*q*q*q / b0;
+	double B = 1 - (b1 + b2 + b3);
+
+	int rows = image.rows, cols = image.cols;
+	Mat smoothed(rows, cols, CV_32FC1);
+
+	// horizontal: forward and backward pass per row, borders continued constantly
+	vector<double> w(cols);
+	for (int y = 0; y < rows; y++) {
+		const float* in = image.ptr<float>(y);
+		float* out = smoothed.ptr<float>(y);
+		double p1 = in[0], p2 = in[0], p3 = in[0];
+		for (int x = 0; x < cols; x++) {
+			w[x] = B*in[x] + b1*p1 + b2*p2 + b3*p3;
+			p3 = p2; p2 = p1; p1 = w[x];
+		}
+		p1 = p2 = p3 = w[cols - 1];
+		for (int x = cols - 1; x >= 0; x--) {
+			double v = B*w[x] + b1*p1 + b2*p2 + b3*p3;
+			p3 = p2; p2 = p1; p1 = v;
+			out[x] = v;
+		}
+	}
+
+	// vertical: the same recursion, but on whole rows; rows before the first (after the last) row
+	// are continued constantly, i.e. equal to the first (last) filtered row
+	Mat forward(rows, cols, CV_64FC1);
+	for (int y = 0; y < rows; y++) {
+		const float* in = smoothed.ptr<float>(y);
+		const double* p1 = forward.ptr<double>(std::max(y - 1, 0));
+		const double* p2 = forward.ptr<double>(std::max(y - 2, 0));
+		const double* p3 = forward.ptr<double>(std::max(y - 3, 0));
+		double* cur = forward.ptr<double>(y);
+		for (int x = 0; x < cols; x++) {
+			cur[x] = (y == 0) ? in[x] : B*in[x] + b1*p1[x] + b2*p2[x] + b3*p3[x];
+		}
+	}
+	for (int y = rows - 1; y >= 0; y--) {
+		const double* in = forward.ptr<double>(y);
+		const float* p1 = smoothed.ptr<float>(std::min(y + 1, rows - 1));
+		const float* p2 = smoothed.ptr<float>(std::min(y + 2, rows - 1));
+		const float* p3 = smoothed.ptr<float>(std::min(y + 3, rows - 1));
+		float* cur = smoothed.ptr<float>(y);
+		for (int x = 0; x < cols; x++) {
+			cur[x] = (y == rows - 1) ? in[x] : B*in[x] + b1*p1[x] + b2*p2[x] + b3*p3[x];
+		}
+	}
+
+	// central differences in both directions, written into both channels at once
+	for (int y = 0; y < rows; y++) {
+		const float* up = smoothed.ptr<float>(std::max(y - 1, 0));
+		const float* cur = smoothed.ptr<float>(y);
+		const float* down = smoothed.ptr<float>(std::min(y + 1, rows - 1));
+		Vec2f* out = output.ptr<Vec2f>(y);
+		for (int x = 0; x < cols; x++) {
+			float left = cur[std::max(x - 1, 0)];
+			float right = cur[std::min(x + 1, cols - 1)];
+			out[x][0] = -gain * 0.5 * (right - left);
+			out[x][1] = -gain * 0.5 * (down[x] - up[x]);
+		}
+	}
+}
+
 // rotates and scales a given image
 /*
 image:	the image to be scaled and rotated
@@ -474,57 +3960,59 @@ return:	transformed image
 */
 Mat Aia3::rotateAndScale(const Mat& image, double angle, double scale) {
 
+	Size size;
+	Matx33f H = warpMatrix(image.size(), angle, scale, size);
+
+	// warp image and copy it to output image
+	Mat output;
+	warpPerspective(image, output, H, size, CV_INTER_LINEAR);
+
+	return output;
+
+}
+
+// homography of rotateAndScale(..)
+/*
+rotation and scaling about the image center, followed by a translation of the object to the center of the output image
+size:		size of the image to be transformed
+angle:		rotation angle in radians
+scale:		scaling factor
+warpedSize:	size of the transformed image, large enough for the whole transformed image
+return:		the homography
+*/
+Matx33f Aia3::warpMatrix(Size size, double angle, double scale, Size& warpedSize) {
+
 	// create transformation matrices
 	// translation to origin
-	Mat T = Mat::eye(3, 3, CV_32FC1);
-	T.at<float>(0, 2) = -image.cols / 2.0;
-	T.at<float>(1, 2) = -image.rows / 2.0;
-
+	Matx33f T(1, 0, (float)(-size.width / 2.0), 0, 1, (float)(-size.height / 2.0), 0, 0, 1);
 
 	// rotation
-	Mat R = Mat::eye(3, 3, CV_32FC1);
-	R.at<float>(0, 0) = cos(angle);
-	R.at<float>(0, 1) = -sin(angle);
-	R.at<float>(1, 0) = sin(angle);
-	R.at<float>(1, 1) = cos(angle);
+	float c = (float)cos(angle), s = (float)sin(angle);
+	Matx33f R(c, -s, 0, s, c, 0, 0, 0, 1);
 
 	// scale
-	Mat S = Mat::eye(3, 3, CV_32FC1);
-	S.at<float>(0, 0) = scale;
-	S.at<float>(1, 1) = scale;
+	Matx33f S((float)scale, 0, 0, 0, (float)scale, 0, 0, 0, 1);
 
 	// combine
-	Mat H = R * S*T;
+	Matx33f H = R * S * T;
 
 	// compute corners of warped image
-	Mat corners(1, 4, CV_32FC2);
-	corners.at<Vec2f>(0, 0) = Vec2f(0, 0);
-	corners.at<Vec2f>(0, 1) = Vec2f(0, image.rows);
-	corners.at<Vec2f>(0, 2) = Vec2f(image.cols, 0);
-	corners.at<Vec2f>(0, 3) = Vec2f(image.cols, image.rows);
-	perspectiveTransform(corners, corners, H);
-
-	// compute size of resulting image and allocate memory
-	float x_start = min(min(corners.at<Vec2f>(0, 0)[0], corners.at<Vec2f>(0, 1)[0]), min(corners.at<Vec2f>(0, 2)[0], corners.at<Vec2f>(0, 3)[0]));
-	float x_end = max(max(corners.at<Vec2f>(0, 0)[0], corners.at<Vec2f>(0, 1)[0]), max(corners.at<Vec2f>(0, 2)[0], corners.at<Vec2f>(0, 3)[0]));
-	float y_start = min(min(corners.at<Vec2f>(0, 0)[1], corners.at<Vec2f>(0, 1)[1]), min(corners.at<Vec2f>(0, 2)[1], corners.at<Vec2f>(0, 3)[1]));
-	float y_end = max(max(corners.at<Vec2f>(0, 0)[1], corners.at<Vec2f>(0, 1)[1]), max(corners.at<Vec2f>(0, 2)[1], corners.at<Vec2f>(0, 3)[1]));
+	float xs[4], ys[4];
+	for (int k = 0; k < 4; k++) {
+		float x = (k & 2) ? (float)size.width : 0;
+		float y = (k & 1) ? (float)size.height : 0;
+		xs[k] = H(0, 0) * x + H(0, 1) * y + H(0, 2);
+		ys[k] = H(1, 0) * x + H(1, 1) * y + H(1, 2);
+	}
+	float x_start = *std::min_element(xs, xs + 4), x_end = *std::max_element(xs, xs + 4);
+	float y_start = *std::min_element(ys, ys + 4), y_end = *std::max_element(ys, ys + 4);
+	warpedSize = Size((int)(x_end - x_start + 1), (int)(y_end - y_start + 1));
 
 	// create translation matrix in order to copy new object to image center
-	T.at<float>(0, 0) = 1;
-	T.at<float>(1, 1) = 1;
-	T.at<float>(2, 2) = 1;
-	T.at<float>(0, 2) = (x_end - x_start + 1) / 2.0;
-	T.at<float>(1, 2) = (y_end - y_start + 1) / 2.0;
+	Matx33f C(1, 0, (x_end - x_start + 1) / 2.0f, 0, 1, (y_end - y_start + 1) / 2.0f, 0, 0, 1);
 
 	// change homography to take necessary translation into account
-	H = T * H;
-	// warp image and copy it to output image
-	Mat output;
-	warpPerspective(image, output, H, Size(x_end - x_start + 1, y_end - y_start + 1), CV_INTER_LINEAR);
-
-	return output;
-
+	return C * H;
 }
 
 // generates the test image as a transformed version of the template image
@@ -575,7 +4063,7 @@ void Aia3::plotHoughDetectionResult(const Mat& testImage, const vector<Mat>& tem
 	// for all objects
 	for (vector<Scalar>::const_iterator it = objList.begin(); it != objList.end(); it++) {
 		// compute scale and angle of current object
-		scale = (scaleRange[1] - scaleRange[0]) / (scaleSteps - 1)*(*it).val[0] + scaleRange[0];
+		scale = (scaleRange[1] - scaleRange[0]) / scaleSteps * (*it).val[0] + scaleRange[0];
 		angle = ((angleRange[1] - angleRange[0]) / (angleSteps)*(*it).val[1] + angleRange[0]);
 
 		// use scale and angle in order to generate new binary mask of template
@@ -638,22 +4126,37 @@ void Aia3::plotHoughDetectionResult(const Mat& testImage, const vector<Mat>& tem
 // seeks for local maxima within the hough space
 /*
 a local maxima has to be larger than all its 8 spatial neighbors, as well as the largest value at this position for all scales and orientations
+the hough space is first reduced to maximum and best pose per position, hence no further pass over the volume is needed
 houghSpace:	the computed hough space
 objThresh:	relative threshold for maxima in hough space
 objList:	list of detected objects
 */
 void Aia3::findHoughMaxima(const vector< vector<Mat> >& houghSpace, double objThresh, vector<Scalar>& objList) {
 
-	// get maxima over scales and angles
-	Mat maxImage = Mat::zeros(houghSpace.at(0).at(0).rows, houghSpace.at(0).at(0).cols, CV_32FC1);
-
-	for (vector< vector<Mat> >::const_iterator it = houghSpace.begin(); it != houghSpace.end(); it++) {
-
-		for (vector<Mat>::const_iterator img = (*it).begin(); img != (*it).end(); img++) {
-			max(*img, maxImage, maxImage);
+	// get maxima and best pose over scales and angles
+	ReducedHough reduced;
+	for (int s = 0; s < (int)houghSpace.size(); s++) {
+		for (int a = 0; a < (int)houghSpace.at(s).size(); a++) {
+			accumulateHough(houghSpace.at(s).at(a), s, a, reduced);
 		}
 	}
 
+	findHoughMaxima(reduced, objThresh, objList);
+}
+
+// seeks for local maxima within the reduced hough space
+/*
+a local maxima has to be at least as large as all its 8 spatial neighbors; since the maximum image already holds the best response
+over all scales and orientations, this suppresses neighboring scale and angle bins, too
+the maxima are found by comparison with the dilated maximum image; the pose is read from the index maps
+houghSpace:	the reduced hough space
+objThresh:	relative threshold for maxima in hough space
+objList:	list of detected objects
+*/
+void Aia3::findHoughMaxima(const ReducedHough& houghSpace, double objThresh, vector<Scalar>& objList) {
+
+	const Mat& maxImage = houghSpace.maxImage;
+
 	// get global maxima
 	double min, max;
 	minMaxLoc(maxImage, &min, &max);
@@ -661,59 +4164,134 @@ void Aia3::findHoughMaxima(const vector< vector<Mat> >& houghSpace, double objTh
 	// define threshold
 	double threshold = objThresh * max;
 
-	// spatial non-maxima suppression
-	Mat bin = Mat(houghSpace.at(0).at(0).rows, houghSpace.at(0).at(0).cols, CV_32FC1, -1);
-	for (int y = 0; y<maxImage.rows; y++) {
-		for (int x = 0; x<maxImage.cols; x++) {
-			// init
-			bool localMax = true;
-			// check neighbors
-			for (int i = -1; i <= 1; i++) {
-				int new_y = y + i;
-				if ((new_y < 0) || (new_y >= maxImage.rows)) {
-					continue;
-				}
-				for (int j = -1; j <= 1; j++) {
-					int new_x = x + j;
-					if ((new_x < 0) || (new_x >= maxImage.cols)) {
-						continue;
-					}
-					if (maxImage.at<float>(new_y, new_x) > maxImage.at<float>(y, x)) {
-						localMax = false;
-						break;
-					}
-				}
-				if (!localMax)
-					break;
-			}
-			// check if local max is larger than threshold
-			if ((localMax) && (maxImage.at<float>(y, x) > threshold)) {
-				bin.at<float>(y, x) = maxImage.at<float>(y, x);
+	// spatial non-maxima suppression: a position survives if it equals the maximum of its 3x3 neighborhood
+	Mat neighborMax;
+	dilate(maxImage, neighborMax, Mat::ones(3, 3, CV_8UC1));
+	Mat peaks = (maxImage >= neighborMax) & (maxImage > threshold);
+
+	// create object list entries consisting of scale, angle, and position where object was detected
+	for (int y = 0; y < peaks.rows; y++) {
+		const uchar* peak = peaks.ptr<uchar>(y);
+		const float* scaleIdx = houghSpace.scaleIdx.ptr<float>(y);
+		const float* angleIdx = houghSpace.angleIdx.ptr<float>(y);
+		for (int x = 0; x < peaks.cols; x++) {
+			if (!peak[x]) {
+				continue;
 			}
+			Scalar cur;
+			cur.val[0] = scaleIdx[x];
+			cur.val[1] = angleIdx[x];
+			cur.val[2] = x;
+			cur.val[3] = y;
+			objList.push_back(cur);
 		}
 	}
+}
 
-	// loop through hough space after non-max suppression and add objects to object list
-	double scale, angle;
-	scale = 0;
-	for (vector< vector<Mat> >::const_iterator it = houghSpace.begin(); it != houghSpace.end(); it++, scale++) {
-		angle = 0;
-		for (vector<Mat>::const_iterator img = (*it).begin(); img != (*it).end(); img++, angle++) {
-			for (int y = 0; y<bin.rows; y++) {
-				for (int x = 0; x<bin.cols; x++) {
-					if ((*img).at<float>(y, x) == bin.at<float>(y, x)) {
-						// create object list entry consisting of scale, angle, and position where object was detected
-						Scalar cur;
-						cur.val[0] = scale;
-						cur.val[1] = angle;
-						cur.val[2] = x;
-						cur.val[3] = y;
-						objList.push_back(cur);
-					}
-				}
+// refines the detected objects to sub-bin precision
+/*
+the response is interpolated by a parabola through the detected bin and its two neighbors, independently in x, y,
+scale and angle. spatial neighbors are taken from the reduced hough space, responses for neighboring scales and angles
+at the detected position are computed directly in the spatial domain.
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+houghSpace:	the reduced hough space the objects were detected in
+scaleSteps:	scale resolution
+scaleRange:	range of investigated scales [min, max]
+angleSteps:	angle resolution
+angleRange:	range of investigated angles [min, max)
+objList:	list of detected objects; scale, angle and position are replaced by continuous estimates (in units of bins)
+*/
+void Aia3::refineHoughMaxima(const Mat& gradImage, const vector<Mat>& templ, const ReducedHough& houghSpace, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, vector<Scalar>& objList) {
+
+	double scaleStep = (scaleRange[1] - scaleRange[0]) / scaleSteps;
+	double angleStep = (angleRange[1] - angleRange[0]) / angleSteps;
+	bool periodic = fabs(angleRange[1] - angleRange[0] - 2 * CV_PI) < 1e-6;
+	const Mat& maxImage = houghSpace.maxImage;
+
+	for (vector<Scalar>::iterator it = objList.begin(); it != objList.end(); it++) {
+
+		int i = cvRound((*it).val[0]);
+		int j = cvRound((*it).val[1]);
+		int x = cvRound((*it).val[2]);
+		int y = cvRound((*it).val[3]);
+		Point pos(x, y);
+
+		// spatial dimensions
+		if ((x > 0) && (x < maxImage.cols - 1)) {
+			(*it).val[2] = x + parabolicPeak(maxImage.at<float>(y, x - 1), maxImage.at<float>(y, x), maxImage.at<float>(y, x + 1));
+		}
+		if ((y > 0) && (y < maxImage.rows - 1)) {
+			(*it).val[3] = y + parabolicPeak(maxImage.at<float>(y - 1, x), maxImage.at<float>(y, x), maxImage.at<float>(y + 1, x));
+		}
+
+		// scale and angle dimensions
+		double scale = scaleRange[0] + i * scaleStep;
+		double angle = angleRange[0] + j * angleStep;
+		double center = houghResponse(gradImage, templ, scale, angle, pos);
+		// both scale neighbors have to be on the grid
+		if ((i > 0) && (i < scaleSteps - 1)) {
+			double lower = houghResponse(gradImage, templ, scale - scaleStep, angle, pos);
+			double upper = houghResponse(gradImage, templ, scale + scaleStep, angle, pos);
+			(*it).val[0] = i + parabolicPeak(lower, center, upper);
+		}
+		if (periodic || ((j > 0) && (j < angleSteps - 1))) {
+			double lower = houghResponse(gradImage, templ, scale, angle - angleStep, pos);
+			double upper = houghResponse(gradImage, templ, scale, angle + angleStep, pos);
+			double a = j + parabolicPeak(lower, center, upper);
+			if (periodic) {
+				a = fmod(a + angleSteps, angleSteps);
 			}
+			(*it).val[1] = a;
+		}
+	}
+}
+
+// position of the maximum of the parabola through three equidistant samples
+/*
+left:	value at -1
+center:	value at 0
+right:	value at +1
+return:	offset of the maximum in [-0.5, 0.5]; 0 if center is no maximum
+*/
+double Aia3::parabolicPeak(double left, double center, double right) {
+
+	double curvature = left - 2 * center + right;
+	if ((curvature >= 0) || (center < left) || (center < right)) {
+		return 0;
+	}
+	double offset = 0.5 * (left - right) / curvature;
+	return std::max(-0.5, std::min(0.5, offset));
+}
+
+// computes the hough response of a single pose at a single position
+/*
+same value as the correlation computed by generalHough(..), but evaluated directly in the spatial domain
+gradImage:	the gradient image of the test image
+templ:		the template consisting of binary image and complex-valued directional gradient image
+scale:		scale of the template
+angle:		angle of the template
+pos:		position of the object center
+return:		the hough response
+*/
+double Aia3::houghResponse(const Mat& gradImage, const vector<Mat>& templ, double scale, double angle, Point pos) {
+
+	Mat objectMask;
+	makeObjectMask(templ, scale, angle, objectMask);
+
+	// real part of sum over template of image gradient times conjugated template gradient
+	double response = 0;
+	int cx = objectMask.cols / 2, cy = objectMask.rows / 2;
+	for (int v = 0; v < objectMask.rows; v++) {
+		int y = ((pos.y + v - cy) % gradImage.rows + gradImage.rows) % gradImage.rows;
+		for (int u = 0; u < objectMask.cols; u++) {
+			int x = ((pos.x + u - cx) % gradImage.cols + gradImage.cols) % gradImage.cols;
+			const Vec2f& o = objectMask.at<Vec2f>(v, u);
+			const Vec2f& g = gradImage.at<Vec2f>(y, x);
+			response += g[0] * o[0] + g[1] * o[1];
 		}
 	}
+	return fabs(response);
 }
 
 // shows the image
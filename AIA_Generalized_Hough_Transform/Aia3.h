@@ -6,40 +6,282 @@
 // Description : header file for second AIA assignment
 //============================================================================
 
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <queue>
 #include <opencv2/opencv.hpp>
+#include "../AIA_Common/Fft.h"
 
 using namespace std;
 using namespace cv;
 
+// hough space reduced over the scale- and angle-dimensions
+/*
+maxImage:	maximal hough response over all scales and angles at each position
+sumImage:	sum of hough responses over all scales and angles at each position
+scaleIdx:	index of the scale with maximal response at each position
+angleIdx:	index of the angle with maximal response at each position
+*/
+struct ReducedHough {Mat maxImage; Mat sumImage; Mat scaleIdx; Mat angleIdx;};
+
+// one job of the hough transform: a single scale and angle of the template
+struct HoughPose {double scale; double angle; int scaleIdx; int angleIdx;};
+
+// scratch memory of one worker of the parallel hough transform
+/*
+fftMask:	fourier-spectrum of the scaled and rotated template
+spectrum:	product of image- and template-spectrum, inverse transformed in place
+result:		hough response of the current job
+edgeWarp:	buffer of the scaled and rotated binary edge mask (only the upper left corner is used)
+gradWarp:	buffer of the scaled and rotated complex gradients (only the upper left corner is used)
+objectMask:	the template in the spatial domain, circularly shifted and of the size of fftMask
+maskSize:	size of the template last written into objectMask; all elements outside of its footprint are zero
+*/
+struct HoughWorkspace {Mat fftMask; Mat spectrum; Mat result; Mat edgeWarp; Mat gradWarp; Mat objectMask; Size maskSize;};
+
+// fourier-spectra of all scaled and rotated versions of a template for a fixed test image size
+/*
+templ:		the object template the spectra were computed from
+imageSize:	size of the test images the spectra fit to
+poses:		scales and angles (with grid indices) of the spectra
+spectra:	one fourier-spectrum per pose as computed by makeFFTObjectMask(..)
+*/
+struct TemplateBank {vector<Mat> templ; Size imageSize; vector<HoughPose> poses; vector<Mat> spectra;};
+
+// edge pixels sorted by gradient orientation, used for sparse voting
+/*
+entries:	one entry (x, y, re, im) per edge pixel: position (or offset to the template center) and complex gradient
+binStart:	entries of orientation bin b are entries[binStart[b]] ... entries[binStart[b+1]-1]
+*/
+struct RTable {vector<Vec4f> entries; vector<int> binStart;};
+
+// an object tracked over the frames of a video
+/*
+pose:	scale index, angle index and position, as in the object list of findHoughMaxima(..)
+score:	hough response of the last detection
+lost:	whether the object was not found in the last frame
+*/
+struct HoughTrack {Scalar pose; double score; bool lost;};
+
+// execution plan of the hough transform within a memory budget
+/*
+tileSize:	size of the fourier transformation per tile (0: whole image at once)
+jobs:		maximal number of concurrent jobs, i.e. scales and angles processed in parallel
+bank:		whether all template spectra are kept (template bank) or computed on the fly
+fftDepth:	working precision of the fourier transformations (CV_64F or CV_32F)
+memory:		estimated peak memory in MB
+*/
+struct HoughPlan {int tileSize; int jobs; bool bank; int fftDepth; double memory;};
+
+// header of a hough volume file; one scale per plane follows at an offset of one page, then the planes (page aligned)
+/*
+magic:		file identification, "AIAHOUGH"
+depth:		depth of the planes, CV_32F or CV_16U (normalized per plane)
+rows, cols:	size of each plane, i.e. of the test image
+scaleSteps:	number of scales
+angleSteps:	number of angles
+scaleRange:	range of investigated scales [min, max]
+angleRange:	range of investigated angles [min, max)
+*/
+struct HoughVolumeHeader {char magic[8]; int depth; int rows; int cols; int scaleSteps; int angleSteps; double scaleRange[2]; double angleRange[2];};
+
+// full hough space in a memory-mapped file
+/*
+header:	description of the grid
+data:	begin of the mapping, NULL if nothing is mapped
+bytes:	length of the mapping
+scales:	scale of each plane (index scale * angleSteps + angle): response = stored value * scale; one for CV_32F planes
+planes:	one plane per scale and angle pointing into the mapping, outer vector over scales (as returned by generalHough(..))
+*/
+struct HoughVolume {HoughVolumeHeader header; uchar* data; size_t bytes; float* scales; vector< vector<Mat> > planes;};
+
+// one test image on its way through the batch pipeline
+/*
+index:		position in the manifest
+path:		path of the test image
+testImage:	the test image (CV_32FC1), empty if it could not be loaded
+gradImage:	gradient image of the test image
+spectrum:	fourier-spectrum of the gradient image, as computed by imageSpectrum(..)
+houghSpace:	the reduced hough space
+*/
+struct BatchItem {int index; string path; Mat testImage; Mat gradImage; Mat spectrum; ReducedHough houghSpace;};
+
+// queue of limited capacity between two stages of a pipeline
+/*
+push blocks while the queue is full, pop blocks while it is empty; after close, pop returns false once the queue is empty
+*/
+template <typename T>
+class BoundedQueue{
+
+	public:
+		BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {};
+
+		void push(const T& item) {
+			unique_lock<mutex> lock(access);
+			notFull.wait(lock, [this] { return items.size() < capacity; });
+			items.push(item);
+			notEmpty.notify_one();
+		}
+
+		bool pop(T& item) {
+			unique_lock<mutex> lock(access);
+			notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+			if (items.empty()) {
+				return false;
+			}
+			item = items.front();
+			items.pop();
+			notFull.notify_one();
+			return true;
+		}
+
+		void close(void) {
+			lock_guard<mutex> lock(access);
+			closed = true;
+			notEmpty.notify_all();
+		}
+
+	private:
+		size_t capacity;
+		bool closed;
+		queue<T> items;
+		mutex access;
+		condition_variable notFull, notEmpty;
+};
+
 class Aia3{
 
+	friend class HoughSweepBody;
+	friend class TemplateBankBody;
+	friend class HoughVoteBody;
+	friend class HarmonicBody;
+	friend class HoughVolumeBody;
+
 	public:
 		// constructor
-		Aia3(void){};
+		Aia3(void) : maxJobs(0), fftDepth(CV_32F) {};
 		// destructor
 		~Aia3(void){};
 		
 		// processing routine
 		// --> some parameters have to be set in this function
 		void run(string, string);
+		// processing routine for several templates
+		void run(const vector<string>&, string);
 		// testing routine
 		void test(string, float, float);
+		// tracking routine for videos and cameras
+		void track(string, string);
+		// detection service on stdin or a unix domain socket
+		void serve(string, string);
+		// benchmark on synthetic scenes
+		void benchmark(string, const vector<string>&);
+		// pipelined processing of many test images
+		void batch(string, string);
+		// full hough space on disk for offline analysis
+		void writeVolume(string, string, string, int);
+		void inspectVolume(string, double);
 
 	private:
 		// --> these functions need to be edited
 		void makeFFTObjectMask(const vector<Mat>& templ, double scale, double angle, Mat& fftMask);
+		void makeFFTObjectMask(const vector<Mat>& templ, double scale, double angle, Mat& fftMask, HoughWorkspace& ws);
+		void reserveObjectMask(const vector<Mat>& templ, const vector<HoughPose>& poses, Size spectrumSize, HoughWorkspace& ws);
+		void resetObjectMask(Size spectrumSize, Size maskSize, HoughWorkspace& ws);
+		void makeObjectMask(const vector<Mat>& templ, double scale, double angle, Mat& objectMask);
 		vector<Mat> makeObjectTemplate(const Mat& templateImage, double sigma, double templateThresh);
 		vector< vector<Mat> > generalHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange);
+		void generalHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, ReducedHough& houghSpace);
 		void plotHough(const vector< vector<Mat> >& houghSpace);
+		void plotHough(const ReducedHough& houghSpace);
 		// given functions
+		Mat runParams(void);
 		void process(const Mat&, const Mat&, const Mat&);
+		void process(const vector<Mat>& templateImages, const Mat& testImage, const Mat& params, vector< vector<Scalar> >& objLists);
 		Mat makeTestImage(const Mat& temp, double angle, double scale, double* scaleRange);
 		Mat rotateAndScale(const Mat& temp, double angle, double scale);
+		Matx33f warpMatrix(Size size, double angle, double scale, Size& warpedSize);
 		Mat calcDirectionalGrad(const Mat& image, double sigma);
+		void separableDirectionalGrad(const Mat& image, const Mat& smooth, const Mat& deriv, Mat& output);
+		void recursiveDirectionalGrad(const Mat& image, double sigma, double gain, Mat& output);
 		void showImage(const Mat& img, string win, double dur);
 		Mat circShift(const Mat& in, int dx, int dy);
 		void findHoughMaxima(const vector< vector<Mat> >& houghSpace, double objThresh, vector<Scalar>& objList);
+		void findHoughMaxima(const ReducedHough& houghSpace, double objThresh, vector<Scalar>& objList);
+		void refineHoughMaxima(const Mat& gradImage, const vector<Mat>& templ, const ReducedHough& houghSpace, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, vector<Scalar>& objList);
+		double parabolicPeak(double left, double center, double right);
+		double houghResponse(const Mat& gradImage, const vector<Mat>& templ, double scale, double angle, Point pos);
+		// hough space reduction
+		void imageSpectrum(const Mat& gradImage, Mat& spectrum);
+		void correlate(const Mat& imageSpectrum, const Mat& fftMask, Size size, Mat& Correlation_DFT, Mat& result);
+		void correlate(const Mat& imageSpectrum, const Mat& fftMask, Size size, Mat& Correlation_DFT, Mat& result, float& scale);
+		void correlateHough(const Mat& imageSpectrum, const Mat& fftMask, Size size, Mat& Correlation_DFT, int scale, int angle, ReducedHough& houghSpace);
+		void houghSweep(const Mat& imageSpectrum, Size imageSize, const vector<Mat>& templ, const vector<HoughPose>& poses, ReducedHough& houghSpace, const vector<Mat>* spectra = NULL);
+		void makeHoughPoses(double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, vector<HoughPose>& poses);
+		string checkHoughPoses(double scaleSteps, double* scaleRange, double angleSteps, double* angleRange);
+		// template spectrum bank
+		bool updateTemplateBank(const vector<Mat>& templ, Size imageSize, const vector<HoughPose>& poses, TemplateBank& bank);
+		void generalHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, ReducedHough& houghSpace);
+		void generalHough(const Mat& gradImage, const TemplateBank& bank, ReducedHough& houghSpace);
+		// sparse voting
+		void makeRTable(const Mat& complexGrad, double edgeThresh, bool centered, RTable& table);
+		void vote(const RTable& edges, const RTable& rTable, Mat& result);
+		void houghVote(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double edgeThresh, ReducedHough& houghSpace);
+		bool preferHoughVote(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double edgeThresh, bool bank);
+		// coarse-to-fine search
+		void pyramidHough(const Mat& testImage, const vector<Mat>& templ, double sigma, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, int levels, double objThresh, ReducedHough& houghSpace);
+		void initHough(Size size, ReducedHough& houghSpace);
+		void mergeHough(const ReducedHough& part, Rect roi, Point offset, ReducedHough& houghSpace);
+		// adaptive refinement of the scale/angle grid
+		void adaptiveHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, int levels, int numCells, ReducedHough& houghSpace);
+		// memory-mapped hough volume
+		void generalHough(const Mat& gradImage, const vector<Mat>& templ, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, string volumeFile, int depth, HoughVolume& volume);
+		void createHoughVolume(string volumeFile, const HoughVolumeHeader& header, HoughVolume& volume);
+		void openHoughVolume(string volumeFile, HoughVolume& volume);
+		void closeHoughVolume(HoughVolume& volume);
+		void volumePlane(const HoughVolume& volume, int s, int a, Mat& plane);
+		void findHoughMaxima(const HoughVolume& volume, double objThresh, vector<Scalar>& objList);
+		void plotHough(const HoughVolume& volume);
+		// detection without visualization
+		string objectRecords(const vector<Scalar>& objList, const vector<double>& scores, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange);
+		string jsonString(const string& text);
+		void detect(const Mat& testImage, const vector<Mat>& templ, const Mat& params, TemplateBank& bank, vector<Scalar>& objList, vector<double>& scores);
+		// pose tracking
+		bool trackHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double scaleSteps, double angleSteps, bool periodic, int searchRadius, int poseBand, double objThresh, vector<HoughTrack>& tracks);
+		void localHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, Point center, int searchRadius, ReducedHough& houghSpace);
+		// circular harmonics for the angle dimension
+		void circularHarmonics(const Mat& objectMask, int numHarmonics, vector<Mat>& harmonics, vector<int>& orders);
+		void harmonicHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, int numHarmonics, ReducedHough& houghSpace);
+		// tiled correlation
+		int tiledHough(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, int tileSize, ReducedHough& houghSpace, const Mat* candidates = NULL);
+		int tileSweep(const Mat& gradImage, Size tileSize, int radius, const vector<Mat>& templ, const vector<HoughPose>& poses, const vector<Mat>& spectra, ReducedHough& houghSpace, const Mat* candidates = NULL);
+		// octave pyramid for the scale dimension
+		int octaveHough(const Mat& testImage, const vector<Mat>& templ, double sigma, const vector<HoughPose>& poses, ReducedHough& houghSpace);
+		void edgeCandidates(const Mat& gradImage, const vector<Mat>& templ, const vector<HoughPose>& poses, double roiThresh, Mat& candidates);
+		int tileRadius(const vector<Mat>& templ, double scale);
+		void wrapCopy(const Mat& src, Point origin, Mat& dst);
+		// fourier-mellin pre-estimation of scale and rotation
+		void fourierMellin(const Mat& templGrad, const Mat& gradImage, int numPeaks, vector<Vec2d>& candidates);
+		void bandHoughPoses(const vector<Vec2d>& candidates, int band, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange, vector<HoughPose>& poses);
+
+		// memory budget
+		bool planHough(Size imageSize, const vector<Mat>& templ, const vector<HoughPose>& poses, double memoryLimit, double bankLimit, bool tiled, HoughPlan& plan);
+		double planMemory(Size imageSize, int tileSize, int numPoses, int jobs, bool bank, int fftDepth);
+
+		// test function
+		void test_octaveHough(const Mat& templateImage);
+		void test_fft(void);
+
+		// maximal number of concurrent jobs of the hough transform (0: one per thread)
+		int maxJobs;
+		// working precision of the fourier transformations (CV_32F or CV_64F)
+		int fftDepth;
+		// spectra of the last template, reused as long as template, image size and poses do not change
+		TemplateBank templateBank;
+		// spectra of the last templates used for multi-template detection
+		vector<TemplateBank> templateBanks;
+		void accumulateHough(const Mat& result, int scale, int angle, ReducedHough& houghSpace);
 		void plotHoughDetectionResult(const Mat& testImage, const vector<Mat>& templ, const vector<Scalar>& objList, double scaleSteps, double* scaleRange, double angleSteps, double* angleRange);
 		
 };
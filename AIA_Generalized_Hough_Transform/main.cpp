@@ -15,31 +15,80 @@ using namespace std;
 /* usage:
   first case (testing): aia3 <path to template>
   second case (application): aia3 <path to template> <path to testimage>
+  third case (several templates): aia3 <path to template> <path to testimage> <path to template> ...
+  fourth case (tracking): aia3 -video <path to template> <path to video or camera index>
+  fifth case (service): aia3 -serve <path to template> [<path to unix domain socket>]
+  sixth case (benchmark): aia3 -benchmark <path to template> [<option>=<value> ...]
+  seventh case (batch): aia3 -batch <path to template> <path to manifest of test images>
+  eighth case (hough volume): aia3 -volume <path to template> <path to testimage> <path to volume file> [unorm16]
+                              aia3 -inspect <path to volume file> [<relative threshold for maxima>]
 */
+// prints the usage and waits for enter
+int usage(void) {
+
+    cerr << "Usage: aia3 <path to template image> [<path to test image> [<path to further template images>]]" << endl;
+    cerr << "       aia3 -video <path to template image> <path to video or camera index>" << endl;
+    cerr << "       aia3 -serve <path to template image> [<path to unix domain socket>]" << endl;
+    cerr << "       aia3 -benchmark <path to template image> [<option>=<value> ...]" << endl;
+    cerr << "       aia3 -batch <path to template image> <path to manifest of test images>" << endl;
+    cerr << "       aia3 -volume <path to template image> <path to test image> <path to volume file> [unorm16]" << endl;
+    cerr << "       aia3 -inspect <path to volume file> [<relative threshold for maxima>]" << endl;
+    cerr << "Press enter..." << endl;
+    cin.get();
+    return -1;
+}
+
 // main function
 int main(int argc, char** argv) {
 
 	// check if image paths were defined
-    if ( (argc != 2) and (argc != 3) ) {
-	    cerr << "Usage: aia3 <path to template image> [<path to test image>]" << endl;
-	    cerr << "Press enter..." << endl;
-	    cin.get();
-	    return -1;
+    if (argc < 2) {
+	    return usage();
 	}
 
 	// construct processing object
 	Aia3 aia3;
 	
-	if (argc == 2){
+	if ((string(argv[1]) == "-video") && (argc == 4)){
+		// track objects over the frames of a video
+		aia3.track(argv[2], argv[3]);
+	}else if ((string(argv[1]) == "-serve") && ((argc == 3) || (argc == 4))){
+		// answer detection requests without visualization
+		aia3.serve(argv[2], (argc == 4) ? argv[3] : "-");
+	}else if ((string(argv[1]) == "-benchmark") && (argc >= 3)){
+		// measure the hough transform on synthetic scenes
+		vector<string> options(argv + 3, argv + argc);
+		aia3.benchmark(argv[2], options);
+	}else if ((string(argv[1]) == "-batch") && (argc == 4)){
+		// pipelined processing of all test images of the manifest
+		aia3.batch(argv[2], argv[3]);
+	}else if ((string(argv[1]) == "-volume") && ((argc == 5) || ((argc == 6) && (string(argv[5]) == "unorm16")))){
+		// write the full hough space into a memory-mapped file, optionally as 16 bit planes
+		aia3.writeVolume(argv[2], argv[3], argv[4], (argc == 6) ? CV_16U : CV_32F);
+	}else if ((string(argv[1]) == "-inspect") && ((argc == 3) || (argc == 4))){
+		// find maxima in a hough volume file
+		aia3.inspectVolume(argv[2], (argc == 4) ? atof(argv[3]) : 0.53);
+	}else if (argv[1][0] == '-'){
+		// unknown option, or wrong number of arguments for it
+		return usage();
+	}else if (argc == 2){
 		// angle to rotate template image (in degree)
 		float testAngle = 30;
 		// factor to scale template image
 		float testScale = 1.5;
 		// run some test routines
 		aia3.test(argv[1], testAngle, testScale);
-	}else{
+	}else if (argc == 3){
 		// start processing
 		aia3.run(argv[1], argv[2]);
+	}else{
+		// all templates share the test image
+		vector<string> templates;
+		templates.push_back(argv[1]);
+		for (int i = 3; i < argc; i++){
+			templates.push_back(argv[i]);
+		}
+		aia3.run(templates, argv[2]);
 	}
 	
 	return 0;